@@ -0,0 +1,101 @@
+/*
+Arena.c - Arena allocator for the tree classifier
+Copyright (c) 2020 Amélia O. F. da S.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+/*Allocations are aligned to this many bytes*/
+#define ARENA_ALIGN 16
+#define ARENA_ROUND(size) (((size)+ARENA_ALIGN-1)&~(unsigned long)(ARENA_ALIGN-1))
+
+/*A block of an arena. Its memory follows the header*/
+typedef struct _arena_block{
+    struct _arena_block* next;/*The block allocated before this one*/
+    unsigned long size,used;
+}arena_block;
+
+struct _arena{
+    arena_block* head;/*The block being allocated from (the first one is at the end of the list)*/
+    unsigned long block_size;
+};
+
+arena_block* __arena_block(unsigned long size)
+{
+    arena_block* ret=malloc(ARENA_ROUND(sizeof(arena_block))+size);
+    ret->next=NULL;
+    ret->size=size;
+    ret->used=0;
+    return ret;
+}
+
+arena* arena_create(unsigned long block_size)
+{
+    arena* ret=malloc(sizeof(arena));
+    ret->block_size=ARENA_ROUND(block_size?block_size:ARENA_ALIGN);
+    ret->head=__arena_block(ret->block_size);
+    return ret;
+}
+
+void* arena_alloc(arena* a,unsigned long size)
+{
+    arena_block* b;
+    size=ARENA_ROUND(size?size:1);
+    if(a->head->size-a->head->used<size)
+    {
+        b=__arena_block(size>a->block_size?size:a->block_size);
+        b->next=a->head;
+        a->head=b;
+    }
+    b=a->head;
+    b->used+=size;
+    return (char*)b+ARENA_ROUND(sizeof(arena_block))+b->used-size;
+}
+
+void* arena_calloc(arena* a,unsigned long size)
+{
+    void* ret=arena_alloc(a,size);
+    memset(ret,0,size);
+    return ret;
+}
+
+void arena_reset(arena* a)
+{
+    arena_block* b;
+    while(a->head->next)
+    {
+        b=a->head;
+        a->head=b->next;
+        free(b);
+    }
+    a->head->used=0;
+}
+
+void arena_free(arena** a)
+{
+    if(!a||!*a)return;
+    arena_reset(*a);
+    free((*a)->head);
+    free(*a);
+    *a=NULL;
+}
@@ -0,0 +1,40 @@
+/*
+Arena.h - Arena allocator for the tree classifier
+Copyright (c) 2020 Amélia O. F. da S.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+An arena allocator: memory is handed out from big blocks and given back all at once, with arena_reset or arena_free,
+instead of one allocation at a time.
+Arenas aren't thread-safe: only one thread may allocate from an arena at a time (any may read what was allocated).
+*/
+typedef struct _arena arena;
+
+/*Creates an arena whose blocks hold <block_size> bytes (allocations larger than that get a block of their own)*/
+arena* arena_create(unsigned long block_size);
+/*Allocates <size> bytes, aligned for any type. The memory is valid until the arena is reset or freed*/
+void* arena_alloc(arena* a,unsigned long size);
+/*Same as arena_alloc, but the memory is zeroed*/
+void* arena_calloc(arena* a,unsigned long size);
+/*Gives back everything that was allocated, keeping the first block for the next allocations*/
+void arena_reset(arena* a);
+/*Frees an arena and everything allocated from it*/
+void arena_free(arena** a);
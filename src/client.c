@@ -0,0 +1,366 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "treeClassifier.h"
+
+/*
+Client and load generator for build/server (see server.c for the protocol).
+With just a socket and a .csv file, it classifies the lines of the file and prints their classes. Given a number of
+connections, it sends requests of the lines of the file from all of them at once, and reports the throughput and the
+latency of the requests.
+*/
+
+#define MAX_FRAME (64<<20)
+
+/*The lines of the input file, encoded for requests*/
+typedef struct _encoded{
+    unsigned char* data;
+    size_t* offsets;/*Line i is data[offsets[i]] to data[offsets[i+1]]*/
+    int len;
+}encoded;
+
+/*A connection of the load generator*/
+typedef struct _conn{
+    const char* path;
+    encoded* lines;
+    int requests,per_request,first;
+    double* latencies;/*Of the requests that got a response*/
+    int done;/*Requests that got a response*/
+    long classified;
+    char failed;
+}conn;
+
+int read_full(int fd,void* buf,size_t len)
+{
+    ssize_t n;
+    while(len)
+    {
+        if((n=read(fd,buf,len))<=0)return 0;
+        buf=(char*)buf+n;
+        len-=n;
+    }
+    return 1;
+}
+
+int write_full(int fd,const void* buf,size_t len)
+{
+    ssize_t n;
+    while(len)
+    {
+        if((n=write(fd,buf,len))<=0)return 0;
+        buf=(const char*)buf+n;
+        len-=n;
+    }
+    return 1;
+}
+
+unsigned char* read_frame(int fd,unsigned int* len)
+{
+    unsigned char* ret;
+    if(!read_full(fd,len,sizeof(unsigned int))||*len>MAX_FRAME)return NULL;
+    ret=malloc(*len+1);
+    if(!read_full(fd,ret,*len))
+    {
+        free(ret);
+        return NULL;
+    }
+    return ret;
+}
+
+double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC,&t);
+    return t.tv_sec+t.tv_nsec*1e-9;
+}
+
+/*Connects to the server and reads the columns of its model (as labels, without sublabels)*/
+int connect_server(const char* path,tree_ll** columns)
+{
+    struct sockaddr_un addr;
+    int fd=socket(AF_UNIX,SOCK_STREAM,0);
+    unsigned int len,cols,i;
+    unsigned char* schema,*p;
+    char name[64];
+    label* lab;
+    memset(&addr,0,sizeof(addr));
+    addr.sun_family=AF_UNIX;
+    strncpy(addr.sun_path,path,sizeof(addr.sun_path)-1);
+    if(fd<0||connect(fd,(struct sockaddr*)&addr,sizeof(addr))<0)
+    {
+        if(fd>=0)close(fd);
+        return -1;
+    }
+    if(!(schema=read_frame(fd,&len)))
+    {
+        close(fd);
+        return -1;
+    }
+    if(columns)
+    {
+        memcpy(&cols,schema,sizeof(unsigned int));
+        for(i=0,p=schema+sizeof(unsigned int);i<cols;i++)
+        {
+            memcpy(name,p+2,p[1]);
+            name[p[1]]=0;
+            lab=Label(name,p[0]);
+            ll_push(columns,lab);
+            p+=2+p[1];
+        }
+    }
+    free(schema);
+    return fd;
+}
+
+/*Splits <line> at every comma (empty fields included), keeping up to <max> fields on <fields>. Returns the number of fields*/
+int split_fields(char* line,char** fields,int max)
+{
+    int n=0;
+    char* next;
+    while(1)
+    {
+        if((next=strchr(line,',')))*next=0;
+        if(n<max)fields[n]=line;
+        n++;
+        if(!next)return n;
+        line=next+1;
+    }
+}
+
+/*
+Encodes the lines of a .csv file for the columns of the server (columns the file doesn't have are sent empty).
+Returns 0 if the file can't be read or a line doesn't have as many fields as the header.
+*/
+int encode_file(const char* fname,tree_ll* columns,encoded* out)
+{
+    FILE* fp=fopen(fname,"r");
+    char* line=NULL,*field,*end;
+    char** header,**fields;
+    int cols,i,k,n,ncols=ll_len(&columns),*map,number=1,ok=1;
+    size_t cap=4096,used=0,flen,linecap=0;
+    double value;
+    tree_ll* col;
+    if(!fp||getline(&line,&linecap,fp)<0)
+    {
+        printf("File not found.\n");
+        if(fp)fclose(fp);
+        free(line);
+        return 0;
+    }
+    line[strcspn(line,"\r\n")]=0;
+    /*A line of n characters has at most n+1 fields*/
+    header=malloc(sizeof(char*)*(strlen(line)+1));
+    cols=split_fields(line,header,strlen(line)+1);
+    for(i=0;i<cols;i++)header[i]=strdup(header[i]);
+    map=malloc(sizeof(int)*(ncols+1));
+    for(col=columns,k=0;col;col=col->next,k++)
+        for(map[k]=-1,i=0;i<cols;i++)if(strncmp(header[i],((label*)col->self)->name,64)==0)map[k]=i;
+    fields=malloc(sizeof(char*)*(cols+1));
+    out->data=malloc(cap);
+    out->offsets=malloc(sizeof(size_t));
+    out->offsets[0]=0;
+    out->len=0;
+    while(getline(&line,&linecap,fp)>=0)
+    {
+        number++;
+        line[strcspn(line,"\r\n")]=0;
+        if(!line[0])continue;
+        if((n=split_fields(line,fields,cols))!=cols)
+        {
+            /*Dropping the line would leave the classes out of step with the lines*/
+            printf("Format error at line %d: csv has %d fields instead of %d\n",number,n,cols);
+            ok=0;
+            break;
+        }
+        /*At most a double or a 64 byte name per column*/
+        while(cap-used<(size_t)ncols*64)out->data=realloc(out->data,(cap*=2));
+        for(col=columns,k=0;col;col=col->next,k++)
+        {
+            field=map[k]>=0?fields[map[k]]:"";
+            if(((label*)col->self)->type==LABEL_NUM)
+            {
+                value=strtod(field,&end);
+                if(*end||!*field)value=0;
+                memcpy(out->data+used,&value,sizeof(double));
+                used+=sizeof(double);
+            }
+            else
+            {
+                flen=strlen(field)<63?strlen(field):63;
+                out->data[used]=flen;
+                memcpy(out->data+used+1,field,flen);
+                used+=1+flen;
+            }
+        }
+        out->offsets=realloc(out->offsets,sizeof(size_t)*(out->len+2));
+        out->offsets[++out->len]=used;
+    }
+    for(i=0;i<cols;i++)free(header[i]);
+    free(header);
+    free(fields);
+    free(map);
+    free(line);
+    fclose(fp);
+    if(!ok)
+    {
+        free(out->data);
+        free(out->offsets);
+    }
+    return ok;
+}
+
+/*Sends lines <first> to <first>+<len> (wrapping around the file) as a request. Returns the response*/
+unsigned char* request(int fd,encoded* lines,int first,int len,unsigned int* outlen)
+{
+    size_t size=sizeof(unsigned int),off,n;
+    unsigned int framelen,rows=len;
+    unsigned char* buf;
+    int i,k;
+    for(i=0;i<len;i++)
+    {
+        k=(first+i)%lines->len;
+        size+=lines->offsets[k+1]-lines->offsets[k];
+    }
+    buf=malloc(size+sizeof(unsigned int));
+    framelen=size;
+    memcpy(buf,&framelen,sizeof(unsigned int));
+    memcpy(buf+sizeof(unsigned int),&rows,sizeof(unsigned int));
+    for(i=0,off=2*sizeof(unsigned int);i<len;i++)
+    {
+        k=(first+i)%lines->len;
+        n=lines->offsets[k+1]-lines->offsets[k];
+        memcpy(buf+off,lines->data+lines->offsets[k],n);
+        off+=n;
+    }
+    if(!write_full(fd,buf,off))
+    {
+        free(buf);
+        return NULL;
+    }
+    free(buf);
+    return read_frame(fd,outlen);
+}
+
+void* run_connection(void* arg)
+{
+    conn* c=arg;
+    int fd=connect_server(c->path,NULL),i;
+    unsigned int len,rows;
+    unsigned char* resp;
+    double start;
+    c->classified=0;
+    c->done=0;
+    c->failed=fd<0;
+    for(i=0;i<c->requests&&!c->failed;i++)
+    {
+        start=now();
+        resp=request(fd,c->lines,c->first+i*c->per_request,c->per_request,&len);
+        if(!resp||len<sizeof(unsigned int))
+        {
+            /*Failed requests don't count for the latency*/
+            free(resp);
+            c->failed=1;
+            break;
+        }
+        c->latencies[c->done++]=now()-start;
+        memcpy(&rows,resp,sizeof(unsigned int));
+        c->classified+=rows;
+        free(resp);
+    }
+    if(fd>=0)close(fd);
+    return NULL;
+}
+
+int dblcmp(const void* a,const void* b)
+{
+    return *(double*)a<*(double*)b?-1:*(double*)a>*(double*)b;
+}
+
+int main(int argc,char** argv)
+{
+    tree_ll* columns=NULL;
+    encoded lines;
+    conn* conns;
+    pthread_t* threads;
+    double* latencies,start,elapsed;
+    unsigned char* resp,*p;
+    unsigned int len,rows,i;
+    int fd,nconns,requests,per_request,k,failed=0,done=0;
+    long total=0;
+    if(argc<3)
+    {
+        printf("Usage: %s <socket> <input.csv> [connections] [requests per connection] [lines per request]\n",argv[0]);
+        printf("Prints the class of each line of <input.csv>, or with [connections], measures the server under load.\n");
+        return 1;
+    }
+    if((fd=connect_server(argv[1],&columns))<0)
+    {
+        printf("Could not connect to \"%s\".\n",argv[1]);
+        return 1;
+    }
+    if(!encode_file(argv[2],columns,&lines))return 1;
+    if(!lines.len)
+    {
+        printf("No lines to classify in \"%s\".\n",argv[2]);
+        return 1;
+    }
+    if(argc<4)
+    {
+        /*The whole file in one request*/
+        if(!(resp=request(fd,&lines,0,lines.len,&len)))return 1;
+        memcpy(&rows,resp,sizeof(unsigned int));
+        for(i=0,p=resp+sizeof(unsigned int);i<rows;i++,p+=1+*p)printf("%.*s\n",*p,p+1);
+        free(resp);
+        close(fd);
+        return 0;
+    }
+    close(fd);
+    nconns=atoi(argv[3])>0?atoi(argv[3]):1;
+    requests=argc>4&&atoi(argv[4])>0?atoi(argv[4]):1000;
+    per_request=argc>5&&atoi(argv[5])>0?atoi(argv[5]):1;
+    conns=malloc(sizeof(conn)*nconns);
+    threads=malloc(sizeof(pthread_t)*nconns);
+    latencies=calloc((size_t)nconns*requests,sizeof(double));
+    start=now();
+    for(k=0;k<nconns;k++)
+    {
+        conns[k].path=argv[1];
+        conns[k].lines=&lines;
+        conns[k].requests=requests;
+        conns[k].per_request=per_request;
+        conns[k].first=k*per_request;
+        conns[k].latencies=latencies+k*requests;
+        pthread_create(&threads[k],NULL,run_connection,&conns[k]);
+    }
+    for(k=0;k<nconns;k++)
+    {
+        pthread_join(threads[k],NULL);
+        total+=conns[k].classified;
+        failed+=conns[k].failed;
+    }
+    elapsed=now()-start;
+    /*The latencies of the requests that got a response are gathered at the start*/
+    for(k=0;k<nconns;k++)
+    {
+        memmove(latencies+done,conns[k].latencies,sizeof(double)*conns[k].done);
+        done+=conns[k].done;
+    }
+    qsort(latencies,done,sizeof(double),dblcmp);
+    printf("%d connections, %d requests of %d lines each: %ld lines in %.2lfs (%.0lf lines/s)\n",nconns,requests,
+        per_request,total,elapsed,total/elapsed);
+    if(done)printf("Latency: p50 %.3lfms p99 %.3lfms max %.3lfms\n",latencies[done/2]*1e3,latencies[(int)(done*0.99)]*1e3,
+        latencies[done-1]*1e3);
+    if(failed)printf("%d connections failed.\n",failed);
+    free(conns);
+    free(threads);
+    free(latencies);
+    free(lines.data);
+    free(lines.offsets);
+    ll_free_self(&columns);
+    return failed!=0;
+}
@@ -22,13 +22,15 @@ int main()
     printf("#train\n");
     infoDataset(train);
     printf("Fitting...\n");
-    fit_forest(&test,train,"colour",forest_max_size,0.7);
+    fit_forest_oob(&test,train,"colour",forest_max_size,0.7);
     do
     {
-        improvement=fit_forest(&test,train,"colour",forest_max_size,0.7);
+        improvement=fit_forest_oob(&test,train,"colour",forest_max_size,0.7);
         printf("Secondary fitting cycle - improvement: %.2lf\n",improvement);
     }
     while(improvement>0.05||improvement<0);
-    printf("Fitting completed.\nScore: %.2lf\nSize: %d\n",forest_score(test,data,"colour")*100,ll_len(&test));
+    printf("Fitting completed.\nOut-of-bag score: %.2lf\nScore: %.2lf\nSize: %d\n",forest_oob_score(test,train,"colour")*100,forest_score(test,data,"colour")*100,ll_len(&test));
+    /*For build/predict*/
+    if(forest_save(test,data->col_labels,"build/forest.model"))printf("Forest saved to build/forest.model\n");
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "treeClassifier.h"
+
+/*
+Compares the node layouts of compiled forests (see forest_compile_layout): fits a forest of unpruned trees (random trees,
+or extremely randomized ones, whose random thresholds grow them deeper), compiles it with every layout and measures how
+long classifying the lines of the dataset takes with each. Forests of numerical splits are also scored with QuickScorer
+bitvectors (see quickscorer_compile).
+*/
+
+#define REPEATS 5
+
+double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC,&t);
+    return t.tv_sec+t.tv_nsec*1e-9;
+}
+
+int tree_depth(tree_node* root)
+{
+    int ret=0,d;
+    tree_ll* sub;
+    for(sub=root->subtrees;sub;sub=sub->next)if((d=tree_depth(sub->self)+1)>ret)ret=d;
+    return ret;
+}
+
+int main(int argc,char** argv)
+{
+    char* fname=argc>1?argv[1]:"datasets/test.csv",*classfield=argc>2?argv[2]:"colour";
+    char* names[]={"depth-first","breadth-first","hot","van Emde Boas","quickscorer"};
+    char layouts[]={LAYOUT_DEPTH_FIRST,LAYOUT_BREADTH_FIRST,LAYOUT_HOT,LAYOUT_VEB};
+    int trees=argc>3?atoi(argv[3]):20,len,i,k,r,depth=0,nodes=0,bad;
+    dataset* data=csv_to_dataset(fname);
+    forest model=NULL;
+    tree_options opts;
+    tree_ll* tree;
+    tree_node* root;
+    tree_fitter fitter;
+    compiled_forest* compiled;
+    quickscorer* scorer=NULL;
+    double* rows,start,batch,single;
+    label** classes,**expected;
+    if(!data)
+    {
+        printf("File not found.\n");
+        return 1;
+    }
+    if(select_label_index(data->col_labels,classfield)<0)
+    {
+        printf("KeyError: Field \"%s\" does not exist.\n",classfield);
+        return 1;
+    }
+    /*Fully grown trees, the deep ones that layouts matter for: fitted one by one, without the pruning and selection of
+    fit_forest_opts*/
+    tree_options_init(&opts);
+    opts.max_leaves=argc>4?atoi(argv[4]):0;
+    fitter=argc>5&&!strcmp(argv[5],"extra")?fit_extra_tree_opts:fit_random_tree_opts;
+    for(i=0;i<trees;i++)
+    {
+        opts.seed=i+1;
+        root=NULL;
+        fitter(&root,data,classfield,&opts);
+        if(root)ll_push(&model,root);
+    }
+    for(tree=model;tree;tree=tree->next)
+    {
+        nodes+=tree_size(tree->self);
+        if(tree_depth(tree->self)>depth)depth=tree_depth(tree->self);
+    }
+    len=ll_len(&data->lines);
+    rows=dataset_rows(data);
+    classes=malloc(sizeof(label*)*len);
+    expected=malloc(sizeof(label*)*len);
+    printf("%d trees, %d nodes, depth up to %d, %d lines\n",ll_len(&model),nodes,depth,len);
+    printf("%-14s %12s %12s\n","layout","batch ns/line","single ns/line");
+    for(k=0;k<5;k++)
+    {
+        compiled=forest_compile_layout(model,data->col_labels,k<4?layouts[k]:LAYOUT_DEPTH_FIRST,data);
+        if(k==4&&!(scorer=quickscorer_compile(compiled)))
+        {
+            printf("%-14s (categorical splits)\n",names[k]);
+            free_compiled_forest(&compiled);
+            break;
+        }
+        /*Best of a few runs, over every line*/
+        for(r=0,batch=single=1e30;r<REPEATS;r++)
+        {
+            start=now();
+            if(scorer)quickscorer_classify_rows(scorer,rows,len,compiled->cols,1,classes);
+            else compiled_classify_rows(compiled,rows,len,compiled->cols,1,classes);
+            if(now()-start<batch)batch=now()-start;
+            start=now();
+            if(scorer)for(i=0;i<len;i++)classes[i]=quickscorer_classify(scorer,rows+(long)i*compiled->cols);
+            else for(i=0;i<len;i++)classes[i]=compiled_classify(compiled,rows+(long)i*compiled->cols);
+            if(now()-start<single)single=now()-start;
+        }
+        if(!k)for(i=0;i<len;i++)expected[i]=classes[i];
+        for(i=0,bad=0;i<len;i++)bad+=classes[i]!=expected[i];
+        printf("%-14s %12.1lf %12.1lf%s\n",names[k],batch*1e9/len,single*1e9/len,bad?" (different classes!)":"");
+        free_quickscorer(&scorer);
+        free_compiled_forest(&compiled);
+    }
+    free(rows);
+    free(classes);
+    free(expected);
+    free_forest(&model);
+    free_dataset(&data);
+    return 0;
+}
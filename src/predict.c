@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include "treeClassifier.h"
+#include "threadPool.h"
+
+/*
+Classifies a .csv file with a saved forest, writing the class of each line to another .csv file.
+Three stages run at once: a thread parses batches of lines, the thread pool classifies them and another thread writes
+them out. The queues between the stages are bounded, so only a few batches are ever in memory.
+*/
+
+#define QUEUE_SIZE 4
+/*Lines classified by each task*/
+#define TASK_LINES 256
+
+/*A batch of lines on its way through the pipeline*/
+typedef struct _job{
+    dataset* batch;
+    tree_ll** lines;
+    label** classes;
+    int len;
+}job;
+
+/*A bounded queue between two stages. A NULL job marks the end of the input*/
+typedef struct _queue{
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    job* items[QUEUE_SIZE];
+    int head,len;
+}queue;
+
+void queue_init(queue* q)
+{
+    pthread_mutex_init(&q->lock,NULL);
+    pthread_cond_init(&q->changed,NULL);
+    q->head=q->len=0;
+}
+
+void queue_destroy(queue* q)
+{
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->changed);
+}
+
+/*Waits for room on the queue*/
+void queue_push(queue* q,job* j)
+{
+    pthread_mutex_lock(&q->lock);
+    while(q->len==QUEUE_SIZE)pthread_cond_wait(&q->changed,&q->lock);
+    q->items[(q->head+q->len++)%QUEUE_SIZE]=j;
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/*Waits for a job*/
+job* queue_pop(queue* q)
+{
+    job* ret;
+    pthread_mutex_lock(&q->lock);
+    while(!q->len)pthread_cond_wait(&q->changed,&q->lock);
+    ret=q->items[q->head];
+    q->head=(q->head+1)%QUEUE_SIZE;
+    q->len--;
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+    return ret;
+}
+
+typedef struct _reader_stage{
+    csv_reader* reader;
+    int rows;
+    queue* out;
+}reader_stage;
+
+void* read_lines(void* arg)
+{
+    reader_stage* st=arg;
+    job* j;
+    dataset* batch;
+    while((batch=csv_read_batch(st->reader,st->rows)))
+    {
+        j=malloc(sizeof(job));
+        j->batch=batch;
+        j->len=ll_len(&batch->lines);
+        j->lines=ll_to_array(&batch->lines);
+        j->classes=malloc(sizeof(label*)*j->len);
+        queue_push(st->out,j);
+    }
+    queue_push(st->out,NULL);
+    return NULL;
+}
+
+typedef struct _writer_stage{
+    FILE* fp;
+    queue* in;
+    long lines;
+}writer_stage;
+
+void* write_lines(void* arg)
+{
+    writer_stage* st=arg;
+    job* j;
+    int i;
+    while((j=queue_pop(st->in)))
+    {
+        for(i=0;i<j->len;i++)fprintf(st->fp,"%s\n",j->classes[i]?j->classes[i]->name:"");
+        st->lines+=j->len;
+        csv_free_batch(&j->batch);
+        free(j->lines);
+        free(j->classes);
+        free(j);
+    }
+    return NULL;
+}
+
+/*A range of lines of a batch to be classified on the pool*/
+typedef struct _classify_task{
+    forest model;
+    job* j;
+    int start,end;
+}classify_task;
+
+void classify_lines(void* arg)
+{
+    classify_task* t=arg;
+    int i;
+    for(i=t->start;i<t->end;i++)t->j->classes[i]=forest_classify(t->model,t->j->lines[i]->self,t->j->batch->col_labels);
+}
+
+/*Returns the column the classes of <model> belong to*/
+label* class_column(forest model,tree_ll* columns)
+{
+    tree_node* node=model?model->self:NULL;
+    tree_ll* sub;
+    while(node&&node->subtrees)node=node->subtrees->self;
+    if(!node||!node->attribute)return NULL;
+    for(;columns;columns=columns->next)
+        for(sub=((label*)columns->self)->sublabels;sub;sub=sub->next)if(sub->self==node->attribute)return columns->self;
+    return NULL;
+}
+
+double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC,&t);
+    return t.tv_sec+t.tv_nsec*1e-9;
+}
+
+int main(int argc,char** argv)
+{
+    tree_ll* columns;
+    forest model;
+    csv_reader* reader;
+    thread_pool* pool;
+    task_group group;
+    queue parsed,classified;
+    reader_stage rs;
+    writer_stage ws;
+    pthread_t reader_thread,writer_thread;
+    classify_task* tasks=NULL;
+    label* class;
+    job* j;
+    int i,ntasks,rows;
+    double start=now();
+    if(argc<4)
+    {
+        printf("Usage: %s <model> <input.csv> <output.csv> [threads] [lines per batch]\n",argv[0]);
+        printf("Writes the class of each line of <input.csv> (predicted by a model saved with forest_save) to <output.csv>.\n");
+        return 1;
+    }
+    if(!(model=forest_load(argv[1],&columns)))
+    {
+        printf("Could not load model \"%s\".\n",argv[1]);
+        return 1;
+    }
+    if(!(reader=csv_reader_open(argv[2],columns)))
+    {
+        printf("File not found.\n");
+        return 1;
+    }
+    if(!(ws.fp=fopen(argv[3],"w")))
+    {
+        printf("Could not open \"%s\" for writing.\n",argv[3]);
+        return 1;
+    }
+    rows=argc>5?atoi(argv[5]):4096;
+    pool=thread_pool_create(argc>4?atoi(argv[4]):0);
+    class=class_column(model,columns);
+    fprintf(ws.fp,"%s\n",class?class->name:"class");
+    queue_init(&parsed);
+    queue_init(&classified);
+    rs.reader=reader;
+    rs.rows=rows>0?rows:4096;
+    rs.out=&parsed;
+    ws.in=&classified;
+    ws.lines=0;
+    pthread_create(&reader_thread,NULL,read_lines,&rs);
+    pthread_create(&writer_thread,NULL,write_lines,&ws);
+    /*This thread classifies, splitting each batch among the pool*/
+    while((j=queue_pop(&parsed)))
+    {
+        ntasks=(j->len+TASK_LINES-1)/TASK_LINES;
+        tasks=realloc(tasks,sizeof(classify_task)*(ntasks+1));
+        task_group_init(&group);
+        for(i=0;i<ntasks;i++)
+        {
+            tasks[i].model=model;
+            tasks[i].j=j;
+            tasks[i].start=i*TASK_LINES;
+            tasks[i].end=(i+1)*TASK_LINES<j->len?(i+1)*TASK_LINES:j->len;
+            thread_pool_spawn(pool,&group,classify_lines,&tasks[i]);
+        }
+        thread_pool_wait(pool,&group);
+        queue_push(&classified,j);
+    }
+    queue_push(&classified,NULL);
+    pthread_join(reader_thread,NULL);
+    pthread_join(writer_thread,NULL);
+    fclose(ws.fp);
+    printf("%ld lines classified in %.2lfs on %d threads.\n",ws.lines,now()-start,thread_pool_threads(pool));
+    i=csv_reader_failed(reader);
+    free(tasks);
+    queue_destroy(&parsed);
+    queue_destroy(&classified);
+    thread_pool_free(&pool);
+    csv_reader_close(&reader);
+    free_forest(&model);
+    free_columns(&columns);
+    return i;
+}
@@ -0,0 +1,379 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "treeClassifier.h"
+#include "threadPool.h"
+
+/*
+Serves classifications with a saved forest over a Unix domain socket, so the model is loaded only once for every
+program that uses it.
+Protocol (every integer in the byte order of the machine, since both ends are on it):
+Every message is a frame: a 32-bit length, then that many bytes.
+Once connected, the server sends the columns of the model: a 32-bit column count, then for each column its type
+(LABEL_NUM or LABEL_CAT, one byte), the length of its name (one byte) and the name.
+Requests are a 32-bit line count, then each line: every column in order, numerical ones as doubles and categorical ones
+as a length (one byte) and a name. Unknown names (an empty one for the class column, for example) can't be followed by
+the trees.
+Each request is answered, in order, by a 32-bit line count and the class of each line (a length byte and a name, empty
+if the line couldn't be classified).
+Lines of the requests that arrive while a batch is being classified are classified together in the next batch.
+On SIGHUP, the model file is loaded again in the background. Requests that already started are answered by the old
+model, and later ones by the new model, which is expected to have the same columns (the schema is only sent on connect).
+*/
+
+#define MAX_FRAME (64<<20)
+/*Lines classified by each task*/
+#define TASK_LINES 256
+
+/*A request waiting to be classified*/
+typedef struct _request{
+    model* m;/*The model the lines were decoded for*/
+    double* rows;/*The lines, as rows of the model's compiled forest*/
+    label** classes;
+    int len;
+    char done;
+    struct _request* next;
+}request;
+
+/*The requests waiting for the next batch*/
+typedef struct _batcher{
+    pthread_mutex_t lock;
+    pthread_cond_t pending;/*Signalled when a request arrives*/
+    pthread_cond_t finished;/*Broadcast when a batch is done*/
+    request* head,*tail;
+    model_handle* model;
+    thread_pool* pool;
+}batcher;
+
+batcher server;
+char* socket_path,*model_path;
+
+int read_full(int fd,void* buf,size_t len)
+{
+    ssize_t n;
+    while(len)
+    {
+        if((n=read(fd,buf,len))<=0)return 0;
+        buf=(char*)buf+n;
+        len-=n;
+    }
+    return 1;
+}
+
+int write_full(int fd,const void* buf,size_t len)
+{
+    ssize_t n;
+    while(len)
+    {
+        if((n=write(fd,buf,len))<=0)return 0;
+        buf=(const char*)buf+n;
+        len-=n;
+    }
+    return 1;
+}
+
+/*Reads a frame (NULL on errors or once the client leaves)*/
+unsigned char* read_frame(int fd,unsigned int* len)
+{
+    unsigned char* ret;
+    if(!read_full(fd,len,sizeof(unsigned int))||*len>MAX_FRAME)return NULL;
+    if(!(ret=malloc(*len+1)))return NULL;
+    if(!read_full(fd,ret,*len))
+    {
+        free(ret);
+        return NULL;
+    }
+    return ret;
+}
+
+int write_frame(int fd,const unsigned char* buf,unsigned int len)
+{
+    return write_full(fd,&len,sizeof(unsigned int))&&write_full(fd,buf,len);
+}
+
+/*
+Decodes the lines of a request into rows for <m>. Returns the number of lines, or -1 if the frame is malformed or its
+rows can't be allocated
+*/
+int decode_request(model* m,unsigned char* buf,unsigned int len,double** rows)
+{
+    unsigned char* end=buf+len,namelen;
+    unsigned int nrows,i,min_row=0;
+    char name[64];
+    tree_ll* col;
+    double* value;
+    label* lab;
+    *rows=NULL;
+    if(len<sizeof(unsigned int))return -1;
+    memcpy(&nrows,buf,sizeof(unsigned int));
+    buf+=sizeof(unsigned int);
+    /*Every line takes at least a double per numerical column and a length byte per categorical one, so the count can't
+    make us allocate more than the frame could fill*/
+    for(col=m->columns;col;col=col->next)min_row+=((label*)col->self)->type==LABEL_NUM?sizeof(double):1;
+    if(min_row?nrows>(len-sizeof(unsigned int))/min_row:nrows>len)return -1;
+    if(!(*rows=value=malloc(sizeof(double)*((size_t)nrows*m->compiled->cols+1))))return -1;
+    for(i=0;i<nrows;i++)
+    {
+        for(col=m->columns;col;col=col->next)
+        {
+            lab=col->self;
+            if(lab->type==LABEL_NUM)
+            {
+                if(end-buf<(long)sizeof(double))goto fail;
+                memcpy(value++,buf,sizeof(double));
+                buf+=sizeof(double);
+            }
+            else
+            {
+                if(end-buf<1||(namelen=*buf)>63||end-buf<1+namelen)goto fail;
+                memcpy(name,buf+1,namelen);
+                name[namelen]=0;
+                buf+=1+namelen;
+                /*Unknown names get code -1, which no tree can follow*/
+                *value++=select_label_index(lab->sublabels,name);
+            }
+        }
+    }
+    return nrows;
+    fail:
+    free(*rows);
+    *rows=NULL;
+    return -1;
+}
+
+/*Classifies the lines of a request, as part of a batch*/
+typedef struct _classify_task{
+    request* req;
+    int start,end;
+}classify_task;
+
+void classify_lines(void* arg)
+{
+    classify_task* t=arg;
+    compiled_forest* f=t->req->m->compiled;
+    compiled_classify_rows(f,t->req->rows+(long)t->start*f->cols,t->end-t->start,f->cols,1,t->req->classes+t->start);
+}
+
+/*Takes every pending request and classifies them together*/
+void* run_batches(void* arg)
+{
+    request* batch,*req;
+    classify_task* tasks=NULL;
+    task_group group;
+    int ntasks,i;
+    while(1)
+    {
+        pthread_mutex_lock(&server.lock);
+        while(!server.head)pthread_cond_wait(&server.pending,&server.lock);
+        batch=server.head;
+        server.head=server.tail=NULL;
+        pthread_mutex_unlock(&server.lock);
+        for(ntasks=0,req=batch;req;req=req->next)ntasks+=(req->len+TASK_LINES-1)/TASK_LINES;
+        tasks=realloc(tasks,sizeof(classify_task)*(ntasks+1));
+        task_group_init(&group);
+        for(ntasks=0,req=batch;req;req=req->next)
+        {
+            for(i=0;i<req->len;i+=TASK_LINES)
+            {
+                tasks[ntasks].req=req;
+                tasks[ntasks].start=i;
+                tasks[ntasks].end=i+TASK_LINES<req->len?i+TASK_LINES:req->len;
+                thread_pool_spawn(server.pool,&group,classify_lines,&tasks[ntasks++]);
+            }
+        }
+        thread_pool_wait(server.pool,&group);
+        pthread_mutex_lock(&server.lock);
+        /*The connection threads free their requests, so <next> can't be read after <done> is set*/
+        for(req=batch;req;req=batch)
+        {
+            batch=req->next;
+            req->done=1;
+        }
+        pthread_cond_broadcast(&server.finished);
+        pthread_mutex_unlock(&server.lock);
+    }
+    return NULL;
+}
+
+/*Queues a request and waits for its batch to be classified*/
+void classify_request(request* req)
+{
+    req->done=0;
+    req->next=NULL;
+    pthread_mutex_lock(&server.lock);
+    if(server.tail)server.tail->next=req;
+    else server.head=req;
+    server.tail=req;
+    pthread_cond_signal(&server.pending);
+    while(!req->done)pthread_cond_wait(&server.finished,&server.lock);
+    pthread_mutex_unlock(&server.lock);
+}
+
+/*Sends the columns of the current model*/
+int send_schema(int fd)
+{
+    model* m=model_acquire(server.model);
+    unsigned int cols=ll_len(&m->columns);
+    unsigned char buf[sizeof(unsigned int)+66*(cols+1)],*p=buf+sizeof(unsigned int);
+    tree_ll* col;
+    label* lab;
+    memcpy(buf,&cols,sizeof(unsigned int));
+    for(col=m->columns;col;col=col->next)
+    {
+        lab=col->self;
+        *p++=lab->type;
+        *p=strlen(lab->name);
+        memcpy(p+1,lab->name,*p);
+        p+=1+*p;
+    }
+    model_release(m);
+    return write_frame(fd,buf,p-buf);
+}
+
+void* serve_client(void* arg)
+{
+    int fd=(int)(long)arg,i;
+    unsigned int len,rows;
+    unsigned char* buf,*out=NULL,*p;
+    size_t outlen=0,namelen;
+    request req;
+    if(!send_schema(fd))goto end;
+    while((buf=read_frame(fd,&len)))
+    {
+        /*The lines are decoded for the columns of the model and the classes are its labels, so it's kept until they're sent*/
+        req.m=model_acquire(server.model);
+        req.len=decode_request(req.m,buf,len,&req.rows);
+        free(buf);
+        if(req.len<0)
+        {
+            model_release(req.m);
+            break;
+        }
+        /*Connections whose requests can't be allocated are dropped, rather than taking the server down*/
+        if(!(req.classes=malloc(sizeof(label*)*(req.len+1))))
+        {
+            free(req.rows);
+            model_release(req.m);
+            break;
+        }
+        if(req.len)classify_request(&req);
+        /*Class names are at most 63 characters long*/
+        if(outlen<sizeof(unsigned int)+64*(size_t)req.len)
+        {
+            free(out);
+            if(!(out=malloc((outlen=sizeof(unsigned int)+64*(size_t)req.len))))
+            {
+                free(req.rows);
+                free(req.classes);
+                model_release(req.m);
+                break;
+            }
+        }
+        rows=req.len;
+        memcpy(out,&rows,sizeof(unsigned int));
+        for(i=0,p=out+sizeof(unsigned int);i<req.len;i++)
+        {
+            *p=namelen=req.classes[i]?strlen(req.classes[i]->name):0;
+            if(namelen)memcpy(p+1,req.classes[i]->name,namelen);
+            p+=1+namelen;
+        }
+        free(req.rows);
+        free(req.classes);
+        i=write_frame(fd,out,p-out);
+        model_release(req.m);
+        if(!i)break;
+    }
+    end:
+    free(out);
+    close(fd);
+    return NULL;
+}
+
+/*Reloads the model on every SIGHUP (which is blocked in every other thread)*/
+void* reload_model(void* arg)
+{
+    sigset_t* hup=arg;
+    int sig;
+    while(!sigwait(hup,&sig))
+    {
+        if(model_reload(server.model,model_path))printf("Reloaded \"%s\".\n",model_path);
+        else printf("Could not reload \"%s\", still serving the previous model.\n",model_path);
+        fflush(stdout);
+    }
+    return NULL;
+}
+
+void stop(int sig)
+{
+    unlink(socket_path);
+    _exit(0);
+}
+
+int main(int argc,char** argv)
+{
+    struct sockaddr_un addr;
+    int listener,fd;
+    pthread_t thread;
+    pthread_attr_t detached;
+    sigset_t hup;
+    model* m;
+    if(argc<3)
+    {
+        printf("Usage: %s <model> <socket> [threads]\n",argv[0]);
+        printf("Answers classification requests for a model saved with forest_save on the Unix socket <socket>.\n");
+        return 1;
+    }
+    if(!(server.model=model_open(argv[1])))
+    {
+        printf("Could not load model \"%s\".\n",argv[1]);
+        return 1;
+    }
+    model_path=argv[1];
+    /*Blocked before any thread starts, so that only the reloading thread takes it*/
+    sigemptyset(&hup);
+    sigaddset(&hup,SIGHUP);
+    pthread_sigmask(SIG_BLOCK,&hup,NULL);
+    server.pool=thread_pool_create(argc>3?atoi(argv[3]):0);
+    pthread_mutex_init(&server.lock,NULL);
+    pthread_cond_init(&server.pending,NULL);
+    pthread_cond_init(&server.finished,NULL);
+    server.head=server.tail=NULL;
+    socket_path=argv[2];
+    memset(&addr,0,sizeof(addr));
+    addr.sun_family=AF_UNIX;
+    if(strlen(socket_path)>=sizeof(addr.sun_path))
+    {
+        printf("Socket path too long.\n");
+        return 1;
+    }
+    strcpy(addr.sun_path,socket_path);
+    listener=socket(AF_UNIX,SOCK_STREAM,0);
+    unlink(socket_path);
+    if(listener<0||bind(listener,(struct sockaddr*)&addr,sizeof(addr))<0||listen(listener,64)<0)
+    {
+        perror("Could not listen on the socket");
+        return 1;
+    }
+    signal(SIGINT,stop);
+    signal(SIGTERM,stop);
+    /*Writes to clients that left shouldn't kill the server*/
+    signal(SIGPIPE,SIG_IGN);
+    pthread_create(&thread,NULL,reload_model,&hup);
+    pthread_create(&thread,NULL,run_batches,NULL);
+    pthread_attr_init(&detached);
+    pthread_attr_setdetachstate(&detached,PTHREAD_CREATE_DETACHED);
+    m=model_acquire(server.model);
+    printf("Serving \"%s\" (%d trees) on %s with %d threads.\n",argv[1],ll_len(&m->trees),socket_path,
+        thread_pool_threads(server.pool));
+    model_release(m);
+    fflush(stdout);
+    while((fd=accept(listener,NULL,NULL))>=0)pthread_create(&thread,&detached,serve_client,(void*)(long)fd);
+    perror("accept");
+    unlink(socket_path);
+    return 1;
+}
@@ -0,0 +1,619 @@
+/*
+SimdKernels.c - Vectorized column kernels for the tree classifier
+Copyright (c) 2020 Amélia O. F. da S.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <pthread.h>
+#if defined(__x86_64__)||defined(__i386__)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+#include "simdKernels.h"
+
+/*
+Portable kernels.
+The vectorized ones fill whole words 64 rows at a time and leave the rest to these.
+*/
+
+void __mask_le_scalar(const double* values,int start,int len,double threshold,unsigned long long* mask)
+{
+    int i;
+    for(i=start;i<len;i++)
+    {
+        if(i%64==0)mask[i/64]=0;
+        if(values[i]<=threshold)mask[i/64]|=1ULL<<(i%64);
+    }
+}
+
+void __mask_le_f32_scalar(const float* values,int start,int len,float threshold,unsigned long long* mask)
+{
+    int i;
+    for(i=start;i<len;i++)
+    {
+        if(i%64==0)mask[i/64]=0;
+        if(values[i]<=threshold)mask[i/64]|=1ULL<<(i%64);
+    }
+}
+
+void __mask_eq_scalar(const int* codes,int start,int len,int code,unsigned long long* mask)
+{
+    int i;
+    for(i=start;i<len;i++)
+    {
+        if(i%64==0)mask[i/64]=0;
+        if(codes[i]==code)mask[i/64]|=1ULL<<(i%64);
+    }
+}
+
+void __mask_eq8_scalar(const unsigned char* codes,int start,int len,unsigned char code,unsigned long long* mask)
+{
+    int i;
+    for(i=start;i<len;i++)
+    {
+        if(i%64==0)mask[i/64]=0;
+        if(codes[i]==code)mask[i/64]|=1ULL<<(i%64);
+    }
+}
+
+void __mask_eq16_scalar(const unsigned short* codes,int start,int len,unsigned short code,unsigned long long* mask)
+{
+    int i;
+    for(i=start;i<len;i++)
+    {
+        if(i%64==0)mask[i/64]=0;
+        if(codes[i]==code)mask[i/64]|=1ULL<<(i%64);
+    }
+}
+
+int __mask_and_gt_scalar(const double* values,int start,int len,double threshold,unsigned long long mask,
+    unsigned long long* words)
+{
+    int i,ret=0;
+    for(i=start;i<len;i++)
+    {
+        if(!(values[i]<=threshold))
+        {
+            words[i]&=mask;
+            ret=1;
+        }
+    }
+    return ret;
+}
+
+void mask_le_scalar(const double* values,int len,double threshold,unsigned long long* mask)
+{
+    __mask_le_scalar(values,0,len,threshold,mask);
+}
+
+void mask_le_f32_scalar(const float* values,int len,float threshold,unsigned long long* mask)
+{
+    __mask_le_f32_scalar(values,0,len,threshold,mask);
+}
+
+void mask_eq_scalar(const int* codes,int len,int code,unsigned long long* mask)
+{
+    __mask_eq_scalar(codes,0,len,code,mask);
+}
+
+void mask_eq8_scalar(const unsigned char* codes,int len,unsigned char code,unsigned long long* mask)
+{
+    __mask_eq8_scalar(codes,0,len,code,mask);
+}
+
+void mask_eq16_scalar(const unsigned short* codes,int len,unsigned short code,unsigned long long* mask)
+{
+    __mask_eq16_scalar(codes,0,len,code,mask);
+}
+
+int mask_and_gt_scalar(const double* values,int len,double threshold,unsigned long long mask,unsigned long long* words)
+{
+    return __mask_and_gt_scalar(values,0,len,threshold,mask,words);
+}
+
+int mask_count_scalar(const unsigned long long* mask,int len)
+{
+    int i,ret=0;
+    for(i=0;i<MASK_WORDS(len);i++)ret+=__builtin_popcountll(mask[i]);
+    return ret;
+}
+
+int mask_and_count_scalar(const unsigned long long* a,const unsigned long long* b,int len)
+{
+    int i,ret=0;
+    for(i=0;i<MASK_WORDS(len);i++)ret+=__builtin_popcountll(a[i]&b[i]);
+    return ret;
+}
+
+void mask_and(const unsigned long long* a,const unsigned long long* b,unsigned long long* out,int len)
+{
+    int i;
+    for(i=0;i<MASK_WORDS(len);i++)out[i]=a[i]&b[i];
+}
+
+void mask_andnot(const unsigned long long* a,const unsigned long long* b,unsigned long long* out,int len)
+{
+    int i;
+    for(i=0;i<MASK_WORDS(len);i++)out[i]=a[i]&~b[i];
+}
+
+#ifdef SIMD_X86
+
+/*SSE2 (every x86-64 CPU has it)*/
+
+__attribute__((target("sse2")))
+void mask_le_sse2(const double* values,int len,double threshold,unsigned long long* mask)
+{
+    int i,j,blocks=len/64;
+    unsigned long long word;
+    __m128d t=_mm_set1_pd(threshold);
+    for(i=0;i<blocks;i++)
+    {
+        word=0;
+        for(j=0;j<32;j++)
+            word|=(unsigned long long)_mm_movemask_pd(_mm_cmple_pd(_mm_loadu_pd(values+i*64+j*2),t))<<(j*2);
+        mask[i]=word;
+    }
+    __mask_le_scalar(values,blocks*64,len,threshold,mask);
+}
+
+__attribute__((target("sse2")))
+void mask_le_f32_sse2(const float* values,int len,float threshold,unsigned long long* mask)
+{
+    int i,j,blocks=len/64;
+    unsigned long long word;
+    __m128 t=_mm_set1_ps(threshold);
+    for(i=0;i<blocks;i++)
+    {
+        word=0;
+        for(j=0;j<16;j++)
+            word|=(unsigned long long)_mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(values+i*64+j*4),t))<<(j*4);
+        mask[i]=word;
+    }
+    __mask_le_f32_scalar(values,blocks*64,len,threshold,mask);
+}
+
+__attribute__((target("sse2")))
+void mask_eq_sse2(const int* codes,int len,int code,unsigned long long* mask)
+{
+    int i,j,blocks=len/64;
+    unsigned long long word;
+    __m128i c=_mm_set1_epi32(code);
+    for(i=0;i<blocks;i++)
+    {
+        word=0;
+        for(j=0;j<16;j++)
+            word|=(unsigned long long)_mm_movemask_ps(_mm_castsi128_ps(
+                _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(codes+i*64+j*4)),c)))<<(j*4);
+        mask[i]=word;
+    }
+    __mask_eq_scalar(codes,blocks*64,len,code,mask);
+}
+
+__attribute__((target("sse2")))
+void mask_eq8_sse2(const unsigned char* codes,int len,unsigned char code,unsigned long long* mask)
+{
+    int i,j,blocks=len/64;
+    unsigned long long word;
+    __m128i c=_mm_set1_epi8((char)code);
+    for(i=0;i<blocks;i++)
+    {
+        word=0;
+        for(j=0;j<4;j++)
+            word|=(unsigned long long)(unsigned int)_mm_movemask_epi8(
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(codes+i*64+j*16)),c))<<(j*16);
+        mask[i]=word;
+    }
+    __mask_eq8_scalar(codes,blocks*64,len,code,mask);
+}
+
+__attribute__((target("sse2")))
+void mask_eq16_sse2(const unsigned short* codes,int len,unsigned short code,unsigned long long* mask)
+{
+    int i,j,blocks=len/64;
+    unsigned long long word;
+    __m128i c=_mm_set1_epi16((short)code),a,b;
+    for(i=0;i<blocks;i++)
+    {
+        word=0;
+        for(j=0;j<4;j++)
+        {
+            /*Comparisons give 0 or -1, so packing two of them to bytes keeps them*/
+            a=_mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(codes+i*64+j*16)),c);
+            b=_mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(codes+i*64+j*16+8)),c);
+            word|=(unsigned long long)(unsigned int)_mm_movemask_epi8(_mm_packs_epi16(a,b))<<(j*16);
+        }
+        mask[i]=word;
+    }
+    __mask_eq16_scalar(codes,blocks*64,len,code,mask);
+}
+
+/*cmpnle is true for NaN, which fails every threshold*/
+__attribute__((target("sse2")))
+int mask_and_gt_sse2(const double* values,int len,double threshold,unsigned long long mask,unsigned long long* words)
+{
+    int i,any=0;
+    __m128d t=_mm_set1_pd(threshold),gt;
+    __m128i m=_mm_set1_epi64x(~mask);
+    for(i=0;i+2<=len;i+=2)
+    {
+        gt=_mm_cmpnle_pd(_mm_loadu_pd(values+i),t);
+        any|=_mm_movemask_pd(gt);
+        _mm_storeu_si128((__m128i*)(words+i),
+            _mm_andnot_si128(_mm_and_si128(_mm_castpd_si128(gt),m),_mm_loadu_si128((const __m128i*)(words+i))));
+    }
+    return __mask_and_gt_scalar(values,i,len,threshold,mask,words)|(any!=0);
+}
+
+__attribute__((target("popcnt")))
+int mask_count_popcnt(const unsigned long long* mask,int len)
+{
+    int i,ret=0;
+    for(i=0;i<MASK_WORDS(len);i++)ret+=__builtin_popcountll(mask[i]);
+    return ret;
+}
+
+__attribute__((target("popcnt")))
+int mask_and_count_popcnt(const unsigned long long* a,const unsigned long long* b,int len)
+{
+    int i,ret=0;
+    for(i=0;i<MASK_WORDS(len);i++)ret+=__builtin_popcountll(a[i]&b[i]);
+    return ret;
+}
+
+/*
+AVX2.
+The library is built without optimizations, and GCC only clears the upper halves of the vector registers on its own when
+optimizing: every AVX kernel does it before going back to SSE code, which otherwise stalls on each instruction.
+*/
+
+__attribute__((target("avx2")))
+void mask_le_avx2(const double* values,int len,double threshold,unsigned long long* mask)
+{
+    int i,j,blocks=len/64;
+    unsigned long long word;
+    __m256d t=_mm256_set1_pd(threshold);
+    for(i=0;i<blocks;i++)
+    {
+        word=0;
+        for(j=0;j<16;j++)
+            word|=(unsigned long long)_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(values+i*64+j*4),t,_CMP_LE_OQ))<<(j*4);
+        mask[i]=word;
+    }
+    _mm256_zeroupper();
+    __mask_le_scalar(values,blocks*64,len,threshold,mask);
+}
+
+__attribute__((target("avx2")))
+void mask_le_f32_avx2(const float* values,int len,float threshold,unsigned long long* mask)
+{
+    int i,j,blocks=len/64;
+    unsigned long long word;
+    __m256 t=_mm256_set1_ps(threshold);
+    for(i=0;i<blocks;i++)
+    {
+        word=0;
+        for(j=0;j<8;j++)
+            word|=(unsigned long long)_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(values+i*64+j*8),t,_CMP_LE_OQ))<<(j*8);
+        mask[i]=word;
+    }
+    _mm256_zeroupper();
+    __mask_le_f32_scalar(values,blocks*64,len,threshold,mask);
+}
+
+__attribute__((target("avx2")))
+void mask_eq_avx2(const int* codes,int len,int code,unsigned long long* mask)
+{
+    int i,j,blocks=len/64;
+    unsigned long long word;
+    __m256i c=_mm256_set1_epi32(code);
+    for(i=0;i<blocks;i++)
+    {
+        word=0;
+        for(j=0;j<8;j++)
+            word|=(unsigned long long)_mm256_movemask_ps(_mm256_castsi256_ps(
+                _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(codes+i*64+j*8)),c)))<<(j*8);
+        mask[i]=word;
+    }
+    _mm256_zeroupper();
+    __mask_eq_scalar(codes,blocks*64,len,code,mask);
+}
+
+__attribute__((target("avx2")))
+void mask_eq8_avx2(const unsigned char* codes,int len,unsigned char code,unsigned long long* mask)
+{
+    int i,j,blocks=len/64;
+    unsigned long long word;
+    __m256i c=_mm256_set1_epi8((char)code);
+    for(i=0;i<blocks;i++)
+    {
+        word=0;
+        for(j=0;j<2;j++)
+            word|=(unsigned long long)(unsigned int)_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(codes+i*64+j*32)),c))<<(j*32);
+        mask[i]=word;
+    }
+    _mm256_zeroupper();
+    __mask_eq8_scalar(codes,blocks*64,len,code,mask);
+}
+
+__attribute__((target("avx2")))
+void mask_eq16_avx2(const unsigned short* codes,int len,unsigned short code,unsigned long long* mask)
+{
+    int i,j,blocks=len/64;
+    unsigned long long word;
+    __m256i c=_mm256_set1_epi16((short)code),a,b;
+    for(i=0;i<blocks;i++)
+    {
+        word=0;
+        for(j=0;j<2;j++)
+        {
+            a=_mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i*)(codes+i*64+j*32)),c);
+            b=_mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i*)(codes+i*64+j*32+16)),c);
+            /*Packing works within 128-bit lanes, so the middle quarters have to be swapped back*/
+            word|=(unsigned long long)(unsigned int)_mm256_movemask_epi8(
+                _mm256_permute4x64_epi64(_mm256_packs_epi16(a,b),0xD8))<<(j*32);
+        }
+        mask[i]=word;
+    }
+    _mm256_zeroupper();
+    __mask_eq16_scalar(codes,blocks*64,len,code,mask);
+}
+
+__attribute__((target("avx2")))
+int mask_and_gt_avx2(const double* values,int len,double threshold,unsigned long long mask,unsigned long long* words)
+{
+    int i,any=0;
+    __m256d t=_mm256_set1_pd(threshold),gt;
+    __m256i m=_mm256_set1_epi64x(~mask);
+    for(i=0;i+4<=len;i+=4)
+    {
+        gt=_mm256_cmp_pd(_mm256_loadu_pd(values+i),t,_CMP_NLE_UQ);
+        any|=_mm256_movemask_pd(gt);
+        _mm256_storeu_si256((__m256i*)(words+i),_mm256_andnot_si256(_mm256_and_si256(_mm256_castpd_si256(gt),m),
+            _mm256_loadu_si256((const __m256i*)(words+i))));
+    }
+    _mm256_zeroupper();
+    return __mask_and_gt_scalar(values,i,len,threshold,mask,words)|(any!=0);
+}
+
+/*AVX-512 (comparisons give bitmasks directly)*/
+
+__attribute__((target("avx512f")))
+void mask_le_avx512(const double* values,int len,double threshold,unsigned long long* mask)
+{
+    int i,j,blocks=len/64;
+    unsigned long long word;
+    __m512d t=_mm512_set1_pd(threshold);
+    for(i=0;i<blocks;i++)
+    {
+        word=0;
+        for(j=0;j<8;j++)
+            word|=(unsigned long long)_mm512_cmp_pd_mask(_mm512_loadu_pd(values+i*64+j*8),t,_CMP_LE_OQ)<<(j*8);
+        mask[i]=word;
+    }
+    _mm256_zeroupper();
+    __mask_le_scalar(values,blocks*64,len,threshold,mask);
+}
+
+__attribute__((target("avx512f")))
+void mask_le_f32_avx512(const float* values,int len,float threshold,unsigned long long* mask)
+{
+    int i,j,blocks=len/64;
+    unsigned long long word;
+    __m512 t=_mm512_set1_ps(threshold);
+    for(i=0;i<blocks;i++)
+    {
+        word=0;
+        for(j=0;j<4;j++)
+            word|=(unsigned long long)_mm512_cmp_ps_mask(_mm512_loadu_ps(values+i*64+j*16),t,_CMP_LE_OQ)<<(j*16);
+        mask[i]=word;
+    }
+    _mm256_zeroupper();
+    __mask_le_f32_scalar(values,blocks*64,len,threshold,mask);
+}
+
+__attribute__((target("avx512f")))
+void mask_eq_avx512(const int* codes,int len,int code,unsigned long long* mask)
+{
+    int i,j,blocks=len/64;
+    unsigned long long word;
+    __m512i c=_mm512_set1_epi32(code);
+    for(i=0;i<blocks;i++)
+    {
+        word=0;
+        for(j=0;j<4;j++)
+            word|=(unsigned long long)_mm512_cmpeq_epi32_mask(_mm512_loadu_si512(codes+i*64+j*16),c)<<(j*16);
+        mask[i]=word;
+    }
+    _mm256_zeroupper();
+    __mask_eq_scalar(codes,blocks*64,len,code,mask);
+}
+
+__attribute__((target("avx512bw")))
+void mask_eq8_avx512(const unsigned char* codes,int len,unsigned char code,unsigned long long* mask)
+{
+    int i,blocks=len/64;
+    __m512i c=_mm512_set1_epi8((char)code);
+    for(i=0;i<blocks;i++)mask[i]=_mm512_cmpeq_epi8_mask(_mm512_loadu_si512(codes+i*64),c);
+    _mm256_zeroupper();
+    __mask_eq8_scalar(codes,blocks*64,len,code,mask);
+}
+
+__attribute__((target("avx512bw")))
+void mask_eq16_avx512(const unsigned short* codes,int len,unsigned short code,unsigned long long* mask)
+{
+    int i,blocks=len/64;
+    __m512i c=_mm512_set1_epi16((short)code);
+    for(i=0;i<blocks;i++)
+    {
+        mask[i]=(unsigned long long)_mm512_cmpeq_epi16_mask(_mm512_loadu_si512(codes+i*64),c)|
+            (unsigned long long)_mm512_cmpeq_epi16_mask(_mm512_loadu_si512(codes+i*64+32),c)<<32;
+    }
+    _mm256_zeroupper();
+    __mask_eq16_scalar(codes,blocks*64,len,code,mask);
+}
+
+/*The comparison is a write mask, so only the failing rows' words are ANDed*/
+__attribute__((target("avx512f")))
+int mask_and_gt_avx512(const double* values,int len,double threshold,unsigned long long mask,unsigned long long* words)
+{
+    int i;
+    __mmask8 gt,any=0;
+    __m512d t=_mm512_set1_pd(threshold);
+    __m512i m=_mm512_set1_epi64(mask),w;
+    for(i=0;i+8<=len;i+=8)
+    {
+        gt=_mm512_cmp_pd_mask(_mm512_loadu_pd(values+i),t,_CMP_NLE_UQ);
+        any|=gt;
+        w=_mm512_loadu_si512(words+i);
+        _mm512_storeu_si512(words+i,_mm512_mask_and_epi64(w,gt,w,m));
+    }
+    _mm256_zeroupper();
+    return __mask_and_gt_scalar(values,i,len,threshold,mask,words)|(any!=0);
+}
+
+#endif
+
+/*
+Dispatch
+*/
+
+typedef struct _simd_impl{
+    const char* name;
+    void (*le)(const double* values,int len,double threshold,unsigned long long* mask);
+    void (*le_f32)(const float* values,int len,float threshold,unsigned long long* mask);
+    void (*eq)(const int* codes,int len,int code,unsigned long long* mask);
+    void (*eq8)(const unsigned char* codes,int len,unsigned char code,unsigned long long* mask);
+    void (*eq16)(const unsigned short* codes,int len,unsigned short code,unsigned long long* mask);
+    int (*count)(const unsigned long long* mask,int len);
+    int (*and_count)(const unsigned long long* a,const unsigned long long* b,int len);
+    int (*and_gt)(const double* values,int len,double threshold,unsigned long long mask,unsigned long long* words);
+}simd_impl;
+
+simd_impl __simd={"scalar",mask_le_scalar,mask_le_f32_scalar,mask_eq_scalar,mask_eq8_scalar,mask_eq16_scalar,
+    mask_count_scalar,mask_and_count_scalar,mask_and_gt_scalar};
+pthread_once_t __simd_once=PTHREAD_ONCE_INIT;
+
+void __simd_init(void)
+{
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("popcnt"))
+    {
+        __simd.count=mask_count_popcnt;
+        __simd.and_count=mask_and_count_popcnt;
+    }
+    if(__builtin_cpu_supports("avx512f"))
+    {
+        __simd.name="avx512";
+        __simd.le=mask_le_avx512;
+        __simd.le_f32=mask_le_f32_avx512;
+        __simd.eq=mask_eq_avx512;
+        __simd.and_gt=mask_and_gt_avx512;
+    }
+    else if(__builtin_cpu_supports("avx2"))
+    {
+        __simd.name="avx2";
+        __simd.le=mask_le_avx2;
+        __simd.le_f32=mask_le_f32_avx2;
+        __simd.eq=mask_eq_avx2;
+        __simd.and_gt=mask_and_gt_avx2;
+    }
+    else if(__builtin_cpu_supports("sse2"))
+    {
+        __simd.name="sse2";
+        __simd.le=mask_le_sse2;
+        __simd.le_f32=mask_le_f32_sse2;
+        __simd.eq=mask_eq_sse2;
+        __simd.and_gt=mask_and_gt_sse2;
+    }
+    /*Byte and word comparisons need AVX-512BW, which some AVX-512 CPUs lack*/
+    if(__builtin_cpu_supports("avx512bw"))
+    {
+        __simd.eq8=mask_eq8_avx512;
+        __simd.eq16=mask_eq16_avx512;
+    }
+    else if(__builtin_cpu_supports("avx2"))
+    {
+        __simd.eq8=mask_eq8_avx2;
+        __simd.eq16=mask_eq16_avx2;
+    }
+    else if(__builtin_cpu_supports("sse2"))
+    {
+        __simd.eq8=mask_eq8_sse2;
+        __simd.eq16=mask_eq16_sse2;
+    }
+#endif
+}
+
+void mask_le(const double* values,int len,double threshold,unsigned long long* mask)
+{
+    pthread_once(&__simd_once,__simd_init);
+    __simd.le(values,len,threshold,mask);
+}
+
+void mask_le_f32(const float* values,int len,float threshold,unsigned long long* mask)
+{
+    pthread_once(&__simd_once,__simd_init);
+    __simd.le_f32(values,len,threshold,mask);
+}
+
+void mask_eq(const int* codes,int len,int code,unsigned long long* mask)
+{
+    pthread_once(&__simd_once,__simd_init);
+    __simd.eq(codes,len,code,mask);
+}
+
+void mask_eq8(const unsigned char* codes,int len,unsigned char code,unsigned long long* mask)
+{
+    pthread_once(&__simd_once,__simd_init);
+    __simd.eq8(codes,len,code,mask);
+}
+
+void mask_eq16(const unsigned short* codes,int len,unsigned short code,unsigned long long* mask)
+{
+    pthread_once(&__simd_once,__simd_init);
+    __simd.eq16(codes,len,code,mask);
+}
+
+int mask_count(const unsigned long long* mask,int len)
+{
+    pthread_once(&__simd_once,__simd_init);
+    return __simd.count(mask,len);
+}
+
+int mask_and_count(const unsigned long long* a,const unsigned long long* b,int len)
+{
+    pthread_once(&__simd_once,__simd_init);
+    return __simd.and_count(a,b,len);
+}
+
+int mask_and_gt(const double* values,int len,double threshold,unsigned long long mask,unsigned long long* words)
+{
+    pthread_once(&__simd_once,__simd_init);
+    return __simd.and_gt(values,len,threshold,mask,words);
+}
+
+const char* simd_kernels_name(void)
+{
+    pthread_once(&__simd_once,__simd_init);
+    return __simd.name;
+}
@@ -0,0 +1,57 @@
+/*
+SimdKernels.h - Vectorized column kernels for the tree classifier
+Copyright (c) 2020 Amélia O. F. da S.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+Kernels for comparing a contiguous column against a value, 64 rows at a time.
+Results are packed bitmasks: row i is bit i%64 of word i/64, and a mask for <len> rows takes MASK_WORDS(len) words (the
+bits after the last row are left clear).
+The widest implementation the CPU supports (AVX-512, AVX2 or SSE2) is picked the first time a kernel is called.
+Narrow codes pack more rows per vector: a 512-bit vector compares 64 8-bit codes at once.
+*/
+#define MASK_WORDS(len) (((len)+63)/64)
+
+/*Sets the bits of the rows with values[i]<=threshold*/
+void mask_le(const double* values,int len,double threshold,unsigned long long* mask);
+/*mask_le for single precision values (twice as many rows per vector)*/
+void mask_le_f32(const float* values,int len,float threshold,unsigned long long* mask);
+/*Sets the bits of the rows with codes[i]==code*/
+void mask_eq(const int* codes,int len,int code,unsigned long long* mask);
+/*mask_eq for 8-bit codes*/
+void mask_eq8(const unsigned char* codes,int len,unsigned char code,unsigned long long* mask);
+/*mask_eq for 16-bit codes*/
+void mask_eq16(const unsigned short* codes,int len,unsigned short code,unsigned long long* mask);
+/*Returns the number of bits set on a mask for <len> rows*/
+int mask_count(const unsigned long long* mask,int len);
+/*Returns the number of bits set on both <a> and <b>*/
+int mask_and_count(const unsigned long long* a,const unsigned long long* b,int len);
+/*Stores <a> AND <b> on <out> (which may be one of them)*/
+void mask_and(const unsigned long long* a,const unsigned long long* b,unsigned long long* out,int len);
+/*Stores <a> AND NOT <b> on <out> (which may be one of them)*/
+void mask_andnot(const unsigned long long* a,const unsigned long long* b,unsigned long long* out,int len);
+/*
+ANDs <mask> into words[i] for the rows that fail values[i]<=threshold (NaN fails it), one word per row instead of one
+bit. Returns whether any row failed
+*/
+int mask_and_gt(const double* values,int len,double threshold,unsigned long long mask,unsigned long long* words);
+/*Returns the name of the implementation in use ("avx512", "avx2", "sse2" or "scalar")*/
+const char* simd_kernels_name(void);
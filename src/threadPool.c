@@ -0,0 +1,243 @@
+/*
+ThreadPool.c - A small work-stealing thread pool for the tree classifier
+Copyright (c) 2020 Amélia O. F. da S.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "threadPool.h"
+
+typedef struct _pool_task{
+    void (*func)(void* arg);
+    void* arg;
+    task_group* group;
+}pool_task;
+
+/*
+A worker's task queue.
+The owner pushes and pops at the tail, thieves take from the head.
+*/
+typedef struct _pool_deque{
+    pthread_mutex_t lock;
+    pool_task* tasks;
+    int head,tail,cap;
+}pool_deque;
+
+struct _thread_pool{
+    int threads;/*Worker threads (the pool works with one more: the one that waits)*/
+    pthread_t* workers;
+    pool_deque* deques;/*One per worker, plus a shared one (the last) for threads outside the pool*/
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;/*Signalled when a task group finishes or a task is queued while threads wait on groups*/
+    int waiting;/*Threads blocked in thread_pool_wait*/
+    int queued;/*Tasks waiting on the queues*/
+    char stop;
+};
+
+typedef struct _pool_worker{
+    thread_pool* pool;
+    int idx;
+}pool_worker;
+
+/*The pool the current thread works for and its queue index on it*/
+__thread thread_pool* __pool_self=NULL;
+__thread int __pool_idx=-1;
+
+int pool_own_deque(thread_pool* pool)
+{
+    return __pool_self==pool?__pool_idx:pool->threads;
+}
+
+void deque_push(pool_deque* dq,pool_task task)
+{
+    int i;
+    pthread_mutex_lock(&dq->lock);
+    if(dq->tail==dq->cap)
+    {
+        if(dq->head>0)
+        {
+            /*We reuse the space the thieves left behind*/
+            for(i=dq->head;i<dq->tail;i++)dq->tasks[i-dq->head]=dq->tasks[i];
+            dq->tail-=dq->head;
+            dq->head=0;
+        }
+        else
+        {
+            dq->cap=dq->cap?dq->cap*2:64;
+            dq->tasks=realloc(dq->tasks,sizeof(pool_task)*dq->cap);
+        }
+    }
+    dq->tasks[dq->tail++]=task;
+    pthread_mutex_unlock(&dq->lock);
+}
+
+/*Takes a task from the tail (<steal>=0) or the head (<steal>=1) of a queue*/
+char deque_take(pool_deque* dq,pool_task* task,char steal)
+{
+    char ret=0;
+    pthread_mutex_lock(&dq->lock);
+    if(dq->head<dq->tail)
+    {
+        *task=steal?dq->tasks[dq->head++]:dq->tasks[--dq->tail];
+        if(dq->head==dq->tail)dq->head=dq->tail=0;
+        ret=1;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return ret;
+}
+
+/*Runs one queued task (ours first, then stolen ones). Returns 0 if there was nothing to run*/
+char pool_run_one(thread_pool* pool)
+{
+    int own=pool_own_deque(pool),i,n=pool->threads+1;
+    pool_task task;
+    if(!__atomic_load_n(&pool->queued,__ATOMIC_ACQUIRE))return 0;
+    if(!deque_take(&pool->deques[own],&task,0))
+    {
+        for(i=1;i<n;i++)if(deque_take(&pool->deques[(own+i)%n],&task,1))break;
+        if(i==n)return 0;
+    }
+    __atomic_sub_fetch(&pool->queued,1,__ATOMIC_ACQ_REL);
+    task.func(task.arg);
+    if(!__atomic_sub_fetch(&task.group->pending,1,__ATOMIC_ACQ_REL))
+    {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_broadcast(&pool->done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return 1;
+}
+
+void* pool_worker_main(void* arg)
+{
+    pool_worker* self=arg;
+    thread_pool* pool=self->pool;
+    __pool_self=pool;
+    __pool_idx=self->idx;
+    free(self);
+    while(1)
+    {
+        if(pool_run_one(pool))continue;
+        pthread_mutex_lock(&pool->lock);
+        while(!pool->stop&&!__atomic_load_n(&pool->queued,__ATOMIC_ACQUIRE))pthread_cond_wait(&pool->wake,&pool->lock);
+        if(pool->stop&&!__atomic_load_n(&pool->queued,__ATOMIC_ACQUIRE))
+        {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+thread_pool* thread_pool_create(int threads)
+{
+    int i;
+    pool_worker* worker;
+    thread_pool* ret;
+    if(threads<=0)threads=sysconf(_SC_NPROCESSORS_ONLN);
+    if(threads<=0)threads=1;
+    ret=malloc(sizeof(thread_pool));
+    ret->threads=threads-1;
+    ret->queued=0;
+    ret->waiting=0;
+    ret->stop=0;
+    pthread_mutex_init(&ret->lock,NULL);
+    pthread_cond_init(&ret->wake,NULL);
+    pthread_cond_init(&ret->done,NULL);
+    ret->deques=calloc(ret->threads+1,sizeof(pool_deque));
+    for(i=0;i<=ret->threads;i++)pthread_mutex_init(&ret->deques[i].lock,NULL);
+    ret->workers=malloc(sizeof(pthread_t)*(ret->threads?ret->threads:1));
+    for(i=0;i<ret->threads;i++)
+    {
+        worker=malloc(sizeof(pool_worker));
+        worker->pool=ret;
+        worker->idx=i;
+        pthread_create(&ret->workers[i],NULL,pool_worker_main,worker);
+    }
+    return ret;
+}
+
+void thread_pool_free(thread_pool** pool)
+{
+    int i;
+    if(!pool||!*pool)return;
+    pthread_mutex_lock(&(*pool)->lock);
+    (*pool)->stop=1;
+    pthread_cond_broadcast(&(*pool)->wake);
+    pthread_mutex_unlock(&(*pool)->lock);
+    for(i=0;i<(*pool)->threads;i++)pthread_join((*pool)->workers[i],NULL);
+    for(i=0;i<=(*pool)->threads;i++)
+    {
+        pthread_mutex_destroy(&(*pool)->deques[i].lock);
+        free((*pool)->deques[i].tasks);
+    }
+    pthread_mutex_destroy(&(*pool)->lock);
+    pthread_cond_destroy(&(*pool)->wake);
+    pthread_cond_destroy(&(*pool)->done);
+    free((*pool)->deques);
+    free((*pool)->workers);
+    free(*pool);
+    *pool=NULL;
+}
+
+int thread_pool_threads(thread_pool* pool)
+{
+    return pool?pool->threads+1:1;
+}
+
+void task_group_init(task_group* group)
+{
+    group->pending=0;
+}
+
+void thread_pool_spawn(thread_pool* pool,task_group* group,void func(void* arg),void* arg)
+{
+    pool_task task;
+    task.func=func;
+    task.arg=arg;
+    task.group=group;
+    __atomic_add_fetch(&group->pending,1,__ATOMIC_ACQ_REL);
+    deque_push(&pool->deques[pool_own_deque(pool)],task);
+    __atomic_add_fetch(&pool->queued,1,__ATOMIC_ACQ_REL);
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->wake);
+    if(pool->waiting)pthread_cond_broadcast(&pool->done);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_wait(thread_pool* pool,task_group* group)
+{
+    while(__atomic_load_n(&group->pending,__ATOMIC_ACQUIRE))
+    {
+        /*We help with the work while there is some (the tasks we're waiting for may be stuck behind others)*/
+        if(pool_run_one(pool))continue;
+        /*Otherwise the tasks left are running on other threads: we sleep until the group finishes or more work comes*/
+        pthread_mutex_lock(&pool->lock);
+        pool->waiting++;
+        while(__atomic_load_n(&group->pending,__ATOMIC_ACQUIRE)&&!__atomic_load_n(&pool->queued,__ATOMIC_ACQUIRE))
+            pthread_cond_wait(&pool->done,&pool->lock);
+        pool->waiting--;
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
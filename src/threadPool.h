@@ -0,0 +1,51 @@
+/*
+ThreadPool.h - A small work-stealing thread pool for the tree classifier
+Copyright (c) 2020 Amélia O. F. da S.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+A group of tasks that can be waited on together.
+Initialize it with task_group_init before spawning tasks on it.
+*/
+typedef struct _task_group{
+    int pending;/*Number of spawned tasks that haven't finished yet*/
+}task_group;
+
+/*
+A work-stealing thread pool.
+Every worker keeps its own queue of tasks: it runs the ones it spawned itself last-in-first-out and, when it runs out
+of them, steals the oldest tasks of the other workers. Threads waiting on a task group run tasks while they wait, so
+tasks may spawn and wait on subtasks without deadlocking the pool.
+*/
+typedef struct _thread_pool thread_pool;
+
+/*Creates a pool for <threads> threads (0 for one per core). The thread that waits on the tasks counts as one of them*/
+thread_pool* thread_pool_create(int threads);
+/*Waits for the workers to finish their tasks, then frees the pool*/
+void thread_pool_free(thread_pool** pool);
+/*Returns the number of threads the pool works with*/
+int thread_pool_threads(thread_pool* pool);
+/*Initializes a task group*/
+void task_group_init(task_group* group);
+/*Queues <func>(<arg>) as a task of <group>*/
+void thread_pool_spawn(thread_pool* pool,task_group* group,void func(void* arg),void* arg);
+/*Runs queued tasks until every task of <group> has finished*/
+void thread_pool_wait(thread_pool* pool,task_group* group);
@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "treeClassifier.h"
+
+#define JOBS 6
+#define POOL_THREADS 4
+
+/*A forest training job*/
+typedef struct _job{
+    dataset* data;
+    dataset* train;
+    tree_fitter fitter;
+    unsigned long long seed;
+    forest result;
+    double score;
+    double oob_score;
+}job;
+
+void* run_job(void* arg)
+{
+    job* j=arg;
+    tree_options opts;
+    tree_options_init(&opts);
+    opts.seed=j->seed;
+    opts.max_depth=12;
+    j->result=NULL;
+    fit_forest_opts(&j->result,j->train,"colour",8,0.7,j->fitter,&opts,1);
+    j->score=forest_score(j->result,j->data,"colour");
+    j->oob_score=forest_oob_score(j->result,j->train,"colour");
+    return NULL;
+}
+
+int same_tree(tree_node* a,tree_node* b)
+{
+    tree_ll *sa,*sb;
+    if(!a||!b)return a==b;
+    if(a->attribute!=b->attribute||a->partition!=b->partition||!a->subset!=!b->subset)return 0;
+    if(a->subset&&memcmp(a->subset,b->subset,sizeof(unsigned long long)*((ll_len(&a->attribute->sublabels)+63)/64)))return 0;
+    sa=a->subtrees;
+    sb=b->subtrees;
+    while(sa&&sb)
+    {
+        if(!same_tree(sa->self,sb->self))return 0;
+        sa=sa->next;
+        sb=sb->next;
+    }
+    return !sa&&!sb;
+}
+
+int same_forest(forest a,forest b)
+{
+    while(a&&b)
+    {
+        if(!same_tree(a->self,b->self))return 0;
+        a=a->next;
+        b=b->next;
+    }
+    return !a&&!b;
+}
+
+/*Fits a tree with <fitter> serially and on a pool, splitting small subtrees and features in parallel too*/
+int pool_fit_matches(dataset* data,tree_fitter fitter,unsigned long long seed)
+{
+    tree_options opts;
+    tree_node *serial=NULL,*pooled=NULL;
+    int ret;
+    tree_options_init(&opts);
+    opts.seed=seed;
+    opts.parallel_cutoff=16;
+    opts.parallel_features=1;
+    fitter(&serial,data,"colour",&opts);
+    opts.threads=POOL_THREADS;
+    fitter(&pooled,data,"colour",&opts);
+    ret=same_tree(serial,pooled);
+    free_tree(&serial);
+    free_tree(&pooled);
+    return ret;
+}
+
+int main()
+{
+    srand(time(NULL));
+    printf("Loading training dataset...\n");
+    dataset* data=csv_to_dataset("datasets/test.csv");
+    dataset* train;
+    job serial[JOBS],parallel[JOBS];
+    pthread_t threads[JOBS];
+    tree_fitter fitters[3]={fit_tree_opts,fit_random_tree_opts,fit_extra_tree_opts};
+    char* names[3]={"fit_tree","fit_random_tree","fit_extra_tree"};
+    int i,failures=0;
+    if(!data)
+    {
+        printf("File not found.\n");
+        return 1;
+    }
+    train=sample_dataset(data,ll_len(&data->lines)/2,"colour");
+    for(i=0;i<JOBS;i++)
+    {
+        serial[i].data=data;
+        serial[i].train=train;
+        serial[i].fitter=fitters[i%3];
+        serial[i].seed=rand()+1;
+        parallel[i]=serial[i];
+    }
+    printf("Training %d forests serially...\n",JOBS);
+    for(i=0;i<JOBS;i++)run_job(&serial[i]);
+    printf("Training %d forests on separate threads...\n",JOBS);
+    for(i=0;i<JOBS;i++)pthread_create(&threads[i],NULL,run_job,&parallel[i]);
+    for(i=0;i<JOBS;i++)pthread_join(threads[i],NULL);
+    for(i=0;i<JOBS;i++)
+    {
+        if(!same_forest(serial[i].result,parallel[i].result)||serial[i].score!=parallel[i].score||
+            serial[i].oob_score!=parallel[i].oob_score)
+        {
+            printf("Forest %d: results differ (score %.2lf/%.2lf)\n",i,serial[i].score*100,parallel[i].score*100);
+            failures++;
+        }
+        else printf("Forest %d: same results (score %.2lf, out-of-bag score %.2lf, size %d)\n",i,serial[i].score*100,
+            serial[i].oob_score*100,ll_len(&serial[i].result));
+    }
+    printf("Fitting trees serially and on a pool of %d threads...\n",POOL_THREADS);
+    for(i=0;i<3;i++)
+    {
+        if(!pool_fit_matches(data,fitters[i],rand()+1))
+        {
+            printf("%s: trees differ\n",names[i]);
+            failures++;
+        }
+        else printf("%s: same tree\n",names[i]);
+    }
+    printf(failures?"Stress test failed.\n":"Stress test passed.\n");
+    return failures!=0;
+}
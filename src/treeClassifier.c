@@ -25,7 +25,11 @@ SOFTWARE.
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
 #include "treeClassifier.h"
+#include "threadPool.h"
+#include "simdKernels.h"
+#include "arena.h"
 
 /*
 This macro might make some of the code slightly more easily readable
@@ -114,18 +118,22 @@ void* ll_remove(tree_ll** node)
 }
 void ll_free(tree_ll **list)
 {
-    if(!list||!(*list))return;
-    if((*list)->next!=NULL)ll_free(&(*list)->next);
-    free(*list);
-    *list=NULL;
+    tree_ll* next;
+    if(!list)return;
+    /*Iterative, so long lists don't exhaust the (smaller) stacks of worker threads*/
+    while(*list)
+    {
+        next=(*list)->next;
+        free(*list);
+        *list=next;
+    }
 }
 void ll_free_self(tree_ll **list)
 {
     if(!list||!(*list))return;
-    if((*list)->next!=NULL)ll_free(&(*list)->next);
-    free(*list);
+    if((*list)->next!=NULL)ll_free_self(&(*list)->next);
     if((*list)->self)free((*list)->self);
-    (*list)->self=NULL;
+    free(*list);
     *list=NULL;
 }
 tree_ll* ll_search(tree_ll** list,char func(void* item,void* arg),void* arg)
@@ -137,8 +145,11 @@ tree_ll* ll_search(tree_ll** list,char func(void* item,void* arg),void* arg)
 int ll_len(tree_ll** list)
 {
     int l=0;
-    if(!list||!(*list))return l;
-    return ll_len(&(*list)->next)+1;
+    tree_ll* cur;
+    if(!list)return l;
+    cur=*list;
+    foreach(cur,l++);
+    return l;
 }
 tree_ll** ll_to_array(tree_ll** list)
 {
@@ -184,113 +195,328 @@ label* Label(char* name,char type)
     label* ret=malloc(sizeof(label));
     strcpy(ret->name,name);
     ret->type=type;
+    ret->precision=PRECISION_DOUBLE;
     ret->sublabels=NULL;
     return ret;
 }
 
+dataset* Dataset(tree_ll* col_labels)
+{
+    dataset* ret=malloc(sizeof(dataset));
+    ret->col_labels=col_labels;
+    ret->lines=NULL;
+    ret->cache=NULL;
+    ret->arena=NULL;
+    return ret;
+}
+
+void free_dataset(dataset** ds)
+{
+    if(!ds||!(*ds))return;
+    dataset_changed(*ds);
+    ll_free(&(*ds)->lines);
+    arena_free(&(*ds)->arena);
+    free(*ds);
+    *ds=NULL;
+}
+
+/*Size of the blocks of the arenas that hold the lines of the datasets read from .csv files*/
+#define LINE_ARENA_BLOCK (1<<16)
+
+void csv_options_init(csv_options* opts)
+{
+    opts->columns=NULL;
+    opts->filters=NULL;
+    opts->filter_count=0;
+}
+
+/*
+Reads the fields of a line into <fields> (fields past <cols> are counted but not kept; longer fields are cut at 63
+characters). Fields may be empty. Returns the number of fields, 0 for an empty line or -1 at the end of the file.
+*/
+int __csv_fields(FILE* fp,char (*fields)[64],int cols)
+{
+    int n=0,len=0,c;
+    char extra[64],*field=cols>0?fields[0]:extra;
+    while((c=fgetc(fp))!=EOF&&c!='\n')
+    {
+        if(c==',')
+        {
+            field[len]=0;
+            field=++n<cols?fields[n]:extra;
+            len=0;
+        }
+        else if(len<63)field[len++]=c;
+    }
+    if(!n&&!len)return c==EOF?-1:0;
+    field[len]=0;
+    return n+1;
+}
+
+/*Whether a field passes <filter> (the field is only parsed as far as the filter needs)*/
+char __csv_keep(csv_filter* filter,char* field)
+{
+    char* end,**name;
+    double value;
+    if(filter->type==CSV_RANGE)
+    {
+        value=strtod(field,&end);
+        return end!=field&&*end==0&&value>=filter->min&&value<=filter->max;
+    }
+    for(name=filter->names;name&&*name;name++)if(strncmp(*name,field,64)==0)return 1;
+    return 0;
+}
+
+/*Returns the position of <name> on <names> (a list of <len> header fields), or -1*/
+int __csv_column(char (*names)[64],int len,char* name)
+{
+    int i;
+    for(i=0;i<len;i++)if(strncmp(names[i],name,64)==0)return i;
+    return -1;
+}
+
 dataset* csv_to_dataset(const char* fname)
+{
+    return csv_to_dataset_opts(fname,NULL);
+}
+
+dataset* csv_to_dataset_opts(const char* fname,csv_options* opts)
 {
     if(!fname)return NULL;
     FILE* fp=fopen(fname,"r");
     if(!fp)return NULL;
-    dataset* ret=malloc(sizeof(dataset));
-    char curItem[64];
-    char *tmp;
-    char *ln;
-    double titem;
-    double *item;
-    tree_ll* entry;
-    tree_ll* current_label;
-    tree_ll* srch;
-    int line=3;
-    ret->col_labels=NULL;
-    ret->lines=NULL;
-    /*We use the first line our col_labels*/
-    while(fscanf(fp,"%[^,\n]",curItem))
+    dataset* ret=Dataset(NULL);
+    char curItem[64],(*names)[64]=NULL,(*fields)[64]=NULL,*tmp,**col,*selected,typed=0;
+    int cols=0,c,n,i,k,line=1,entries=0,filters=opts?opts->filter_count:0,*filter_cols=NULL,width=0,numbers=0;
+    double* item;
+    label** labels,*lab;
+    tree_ll* entry,*lines_tail=NULL,*labels_tail=NULL,*srch;
+    /*We use the first line for the column labels*/
+    while(fscanf(fp,"%63[^,\n]%*[^,\n]",curItem)>0)
     {
-        ln=malloc(64);
-        strncpy(ln,curItem,64);
-        ll_push(&ret->col_labels,Label(ln,LABEL_CAT));
-        if(fgetc(fp)=='\n')break;
+        names=realloc(names,sizeof(*names)*(cols+1));
+        strcpy(names[cols++],curItem);
+        if((c=fgetc(fp))=='\n'||c==EOF)break;
     }
-    /*Then we scan the first line*/
-    entry=NULL;
-    current_label=ret->col_labels;
-    while(fscanf(fp,"%[^,\n]",curItem)>0)
+    /*Only the selected columns get a label (the others are skipped over on every line)*/
+    labels=calloc(cols+1,sizeof(label*));
+    selected=calloc(cols+1,1);
+    filter_cols=malloc(sizeof(int)*(filters+1));
+    for(i=0;i<cols;i++)selected[i]=!opts||!opts->columns;
+    for(col=opts?opts->columns:NULL;col&&*col;col++)
     {
-        titem=strtod(curItem,&tmp);
-        if(*tmp!=0)
+        if((i=__csv_column(names,cols,*col))<0)
         {
-            /*If it's not a number, we create a label for it*/
-            ln=malloc(64);
-            strncpy(ln,curItem,64);
-            srch=ll_push(&((label*)current_label->self)->sublabels,Label(ln,LABEL_CAT));
-            ll_push(&entry,srch->self);
+            printf("KeyError: Field \"%s\" does not exist in \"%s\". Could not load dataset.\n",*col,fname);
+            goto fail;
         }
-        else
+        selected[i]=1;
+    }
+    for(k=0;k<filters;k++)
+    {
+        if((filter_cols[k]=__csv_column(names,cols,opts->filters[k].column))<0)
         {
-            /*If it's a number, we allocate a new space to store it and change the field type*/
-            ((label*)current_label->self)->type=LABEL_NUM;
-            item=malloc(sizeof(double));
-            *item=titem;
-            ll_push(&entry,item);
-        }
-        if((curItem[0]=fgetc(fp))=='\n'){
-            ll_push(&ret->lines,entry);
-            break;
+            printf("KeyError: Field \"%s\" does not exist in \"%s\". Could not load dataset.\n",opts->filters[k].column,fname);
+            goto fail;
         }
-        else if(curItem[0]==-1) goto end;
-        else current_label=current_label->next;
     }
-    /*Then we scan each remaining line*/
-    entry=NULL;
-    current_label=ret->col_labels;
-    while(ftell(fp)!=-1&&fscanf(fp,"%[^,\n]",curItem)>0)
+    for(i=0;i<cols;i++)
     {
-        if(((label*)current_label->self)->type==LABEL_NUM)
+        if(!selected[i])continue;
+        labels[i]=Label(names[i],LABEL_CAT);
+        labels_tail=ll_push(labels_tail?&labels_tail:&ret->col_labels,labels[i]);
+        width++;
+    }
+    /*The lines are kept together on the dataset's arena*/
+    ret->arena=arena_create(LINE_ARENA_BLOCK);
+    /*Then we scan each line*/
+    fields=malloc(sizeof(*fields)*(cols+1));
+    while((n=__csv_fields(fp,fields,cols))>=0)
+    {
+        line++;
+        /*Blank lines are skipped*/
+        if(!n)continue;
+        if(n!=cols)
+        {
+            printf("Format error at line %d: csv has %d fields instead of %d\n",line,n,cols);
+            goto fail;
+        }
+        /*Lines that fail a filter are dropped before any of their fields is converted*/
+        for(k=0;k<filters&&__csv_keep(&opts->filters[k],fields[filter_cols[k]]);k++);
+        if(k<filters)continue;
+        if(!typed)
         {
-            titem=strtod(curItem,&tmp);
-            if(*tmp!=0){
-                /*If its's not a number, we throw an error*/
-                printf("Format error at line %d (position %ld): csv contains invalid value \"%s\" for numerical field \"%s\"\n",line,ftell(fp),curItem,((label*)current_label->self)->name);
-                fclose(fp);
-                exit(-1);
+            /*The first line that is kept decides the type of each field*/
+            for(i=0;i<cols;i++)
+            {
+                if(!(lab=labels[i]))continue;
+                strtod(fields[i],&tmp);
+                if(tmp!=fields[i]&&*tmp==0)lab->type=LABEL_NUM;
+                numbers+=lab->type==LABEL_NUM;
+            }
+            typed=1;
+        }
+        /*Each line is a single block: its entries, then its numbers*/
+        entry=arena_alloc(ret->arena,sizeof(tree_ll)*width+sizeof(double)*numbers);
+        item=(double*)(entry+width);
+        for(i=0,k=0;i<cols;i++)
+        {
+            if(!(lab=labels[i]))continue;
+            entry[k].prev=k?&entry[k-1]:NULL;
+            entry[k].next=k+1<width?&entry[k+1]:NULL;
+            if(lab->type==LABEL_NUM)
+            {
+                *item=strtod(fields[i],&tmp);
+                if(tmp==fields[i]||*tmp!=0)
+                {
+                    /*If its's not a number (an empty field isn't either), we throw an error*/
+                    printf("Format error at line %d: csv contains invalid value \"%s\" for numerical field \"%s\"\n",line,fields[i],lab->name);
+                    goto fail;
+                }
+                entry[k].self=item++;
             }
             else
             {
-                /*If it's a number, we allocate a new space to store it*/
-                item=malloc(sizeof(double));
-                *item=titem;
-                ll_push(&entry,item);
+                /*We check if it's a valid label. If it doesn't exist, we create it*/
+                srch=ll_search(&lab->sublabels,findLabel,fields[i]);
+                if(srch==NULL)srch=ll_push(&lab->sublabels,Label(fields[i],LABEL_CAT));
+                entry[k].self=srch->self;
             }
+            k++;
         }
-        else
+        lines_tail=ll_push(lines_tail?&lines_tail:&ret->lines,entry);
+        entries++;
+    }
+    printf("%d entries in dataset.\n",entries);
+    free(fields);
+    free(filter_cols);
+    free(selected);
+    free(labels);
+    free(names);
+    fclose(fp);
+    return ret;
+    fail:
+    /*The labels created so far are all on the dataset's columns, and its lines on its arena*/
+    free(fields);
+    free(filter_cols);
+    free(selected);
+    free(labels);
+    free(names);
+    free_columns(&ret->col_labels);
+    free_dataset(&ret);
+    fclose(fp);
+    return NULL;
+}
+
+struct _csv_reader{
+    FILE* fp;
+    tree_ll* col_labels;/*Labels of the fields that are read, in the file's order*/
+    label** labels;/*Label of each field of the file (NULL for the skipped ones)*/
+    int cols,numbers;/*Fields on the file and numerical fields that are read*/
+    char (*fields)[64];
+    int line;
+    char error;
+};
+
+csv_reader* csv_reader_open(const char* fname,tree_ll* columns)
+{
+    if(!fname)return NULL;
+    FILE* fp=fopen(fname,"r");
+    if(!fp)return NULL;
+    csv_reader* ret=calloc(1,sizeof(csv_reader));
+    char curItem[64];
+    int c;
+    tree_ll* tail=NULL;
+    ret->fp=fp;
+    ret->line=1;
+    /*The header is matched against the columns by name*/
+    while(fscanf(fp,"%63[^,\n]%*[^,\n]",curItem)>0)
+    {
+        ret->labels=realloc(ret->labels,sizeof(label*)*(ret->cols+1));
+        if((ret->labels[ret->cols]=select_label(columns,curItem)))
+        {
+            tail=ll_push(tail?&tail:&ret->col_labels,ret->labels[ret->cols]);
+            if(ret->labels[ret->cols]->type==LABEL_NUM)ret->numbers++;
+        }
+        ret->cols++;
+        if((c=fgetc(fp))=='\n'||c==EOF)break;
+    }
+    ret->fields=malloc(sizeof(*ret->fields)*(ret->cols+1));
+    return ret;
+}
+
+void csv_reader_close(csv_reader** reader)
+{
+    if(!reader||!*reader)return;
+    fclose((*reader)->fp);
+    ll_free(&(*reader)->col_labels);
+    free((*reader)->labels);
+    free((*reader)->fields);
+    free(*reader);
+    *reader=NULL;
+}
+
+dataset* csv_read_batch(csv_reader* reader,int rows)
+{
+    if(!reader||reader->error||rows<1)return NULL;
+    dataset* ret=Dataset(reader->col_labels);
+    int n,i,k,entries=ll_len(&reader->col_labels);
+    ret->arena=arena_create(LINE_ARENA_BLOCK);
+    tree_ll* tail=NULL,*entry;
+    double* item;
+    char* tmp;
+    while(rows&&(n=__csv_fields(reader->fp,reader->fields,reader->cols))>=0)
+    {
+        reader->line++;
+        /*Blank lines are skipped*/
+        if(!n)continue;
+        if(n!=reader->cols)
+        {
+            printf("Format error at line %d: csv has %d fields instead of %d\n",reader->line,n,reader->cols);
+            reader->error=1;
+            break;
+        }
+        /*Each line is a single block: its entries, then its numbers*/
+        entry=arena_alloc(ret->arena,sizeof(tree_ll)*entries+sizeof(double)*reader->numbers);
+        item=(double*)(entry+entries);
+        for(i=0,k=0;i<reader->cols;i++)
         {
-            /*We check if it's a valid label. If it doesn't exist, we create it*/
-            srch=ll_search(&((label*)current_label->self)->sublabels,findLabel,curItem);
-            if(srch==NULL)
+            if(!reader->labels[i])continue;
+            entry[k].prev=k?&entry[k-1]:NULL;
+            entry[k].next=k+1<entries?&entry[k+1]:NULL;
+            if(reader->labels[i]->type==LABEL_NUM)
             {
-                ln=malloc(64);
-                strncpy(ln,curItem,64);
-                srch=ll_push(&((label*)current_label->self)->sublabels,Label(ln,LABEL_CAT));
+                *item=strtod(reader->fields[i],&tmp);
+                if(tmp==reader->fields[i]||*tmp!=0)
+                {
+                    printf("Format error at line %d: csv contains invalid value \"%s\" for numerical field \"%s\"\n",reader->line,reader->fields[i],reader->labels[i]->name);
+                    reader->error=1;
+                }
+                entry[k].self=item++;
             }
-            ll_push(&entry,srch->self);
+            /*Labels the columns don't have can't be followed by any tree*/
+            else entry[k].self=select_label(reader->labels[i]->sublabels,reader->fields[i]);
+            k++;
         }
-        if((curItem[0]=fgetc(fp))=='\n'){
-            ll_push(&ret->lines,entry);
-            entry=NULL;
-            current_label=ret->col_labels;
-            line++;
-        }
-        else if(curItem[0]==-1) break;
-        else current_label=current_label->next;
+        if(reader->error)break;
+        tail=ll_push(tail?&tail:&ret->lines,entry);
+        rows--;
     }
-    end:
-    printf("%d entries in dataset.\n",line-2);
-    fclose(fp);
+    if(!ret->lines)free_dataset(&ret);
     return ret;
 }
 
+char csv_reader_failed(csv_reader* reader)
+{
+    return reader?reader->error:0;
+}
+
+void csv_free_batch(dataset** batch)
+{
+    /*The lines are on the batch's arena*/
+    free_dataset(batch);
+}
+
 void* get_entry_by_label_name(tree_ll* line,tree_ll* column,char* labelname)
 {
     if(!line||!column)return NULL;
@@ -345,6 +571,16 @@ label* select_label_by_index(tree_ll* columns,int idx)
     return select_by_index(columns,idx);
 }
 
+int sublabel_index(tree_ll* sublabels,label* lab)
+{
+    int i=0;
+    foreach(sublabels,{
+        if(sublabels->self==lab)return i;
+        i++;
+    });
+    return -1;
+}
+
 void printDataset(dataset* ds)
 {
     tree_ll *cur,*field,*entry;
@@ -378,1204 +614,3593 @@ void printDataset(dataset* ds)
 void infoDataset(dataset* ds)
 {
     if(!ds)return;
-    tree_ll *field,*entry;
-    field=ds->col_labels;
-    printf("Length: %d\n",ll_len(&ds->lines));
-    while(field)
-    {
-        printf("Field \"%s\":\r\n\t*Type: ",((label*)field->self)->name);
-        if(((label*)field->self)->type==LABEL_NUM)
-            printf("Numerical\r\n\t*Mean: %.4lf\r\n\t*Standard deviation: %.4lf\r\n",
-                mean(ds,((label*)field->self)->name),
-                std_dev(ds,((label*)field->self)->name)
-            );
+    int i,j;
+    column_stats* stats=dataset_stats(ds);
+    tree_ll* entry;
+    if(!stats)return;
+    printf("Length: %d\n",stats->count);
+    for(j=0;j<ll_len(&ds->col_labels);j++)
+    {
+        printf("Field \"%s\":\r\n\t*Type: ",stats[j].column->name);
+        if(stats[j].column->type==LABEL_NUM)
+            printf("Numerical\r\n\t*Mean: %.4lf\r\n\t*Standard deviation: %.4lf\r\n\t*Range: [%.4lf, %.4lf]\r\n",
+                stats[j].mean,sqrt(stats[j].variance),stats[j].min,stats[j].max);
         else
         {
             printf("Categorical\r\n\t*Labels: [ ");
-            entry=((label*)field->self)->sublabels;
-            while(entry)
+            entry=stats[j].column->sublabels;
+            for(i=0;entry;i++)
             {
-                printf("%s (count: %.0lf) ",((label*)entry->self)->name,reduce(ds,((label*)field->self)->name,r_count,entry->self,0));
+                printf("%s (count: %d) ",((label*)entry->self)->name,stats[j].label_counts[i]);
                 entry=entry->next;
             }
             printf("]\r\n");
         }
-        field=field->next;
     }
 }
 
-int __sortbyfield;
-char __sortbyfieldtype;
+/*
+Random numbers (splitmix64)
+*/
 
-int __sortby(const void* a, const void *b)
+void rng_seed(tree_rng* rng,unsigned long long seed)
 {
-    tree_ll *fa=(*((tree_ll**)a))->self,*fb=(*((tree_ll**)b))->self;
-    double va,vb;
-    int i;
-    for(i=0;i<__sortbyfield;i++)
-    {
-        fa=fa->next;
-        fb=fb->next;
-    }
-    if(__sortbyfieldtype==LABEL_NUM)
-    {
-        va=(*((double*)fa->self));
-        vb=(*((double*)fb->self));
-        return (va>vb)?1:(va==vb?0:-1);
-    }
-    else
-    {
-        return (strncmp(((label*)fa->self)->name,((label*)fb->self)->name,64));
-    }
+    rng->state=seed;
 }
 
-int __rsortby(const void* a, const void *b)
+unsigned long long rng_next(tree_rng* rng)
 {
-    tree_ll *fa=(*((tree_ll**)a))->self,*fb=(*((tree_ll**)b))->self;
-    double va,vb;
-    int i;
-    for(i=0;i<__sortbyfield;i++)
-    {
-        fa=fa->next;
-        fb=fb->next;
-    }
-    if(__sortbyfieldtype==LABEL_NUM)
-    {
-        va=(*((double*)fa->self));
-        vb=(*((double*)fb->self));
-        return (va>vb)?-1:(va==vb?0:1);
-    }
-    else
-    {
-        return 1-(strncmp(((label*)fa->self)->name,((label*)fb->self)->name,64));
-    }
+    unsigned long long z=(rng->state+=0x9E3779B97F4A7C15ULL);
+    z=(z^(z>>30))*0xBF58476D1CE4E5B9ULL;
+    z=(z^(z>>27))*0x94D049BB133111EBULL;
+    return z^(z>>31);
 }
 
-void sort_by(dataset* dataset,char* field,char reverse)
+/*Returns a random integer in [0,<n>), from <rng> or from rand() if <rng> is NULL*/
+int rng_below(tree_rng* rng,int n)
 {
-    if(!dataset||!(dataset->col_labels))return;
-    int idx=0;
-    tree_ll* lab=dataset->col_labels;
-    tree_ll**ll;
-    while(lab)
+    if(!rng)return rand()%n;
+    return rng_next(rng)%n;
+}
+
+/*Returns a random number in [0,1)*/
+double rng_uniform(tree_rng* rng)
+{
+    if(!rng)return rand()/(RAND_MAX+1.0);
+    return (rng_next(rng)>>11)*(1.0/9007199254740992.0);
+}
+
+/*
+Stable merge sort for arrays of pointers.
+Unlike qsort, the comparison function gets a context pointer, so there's no need for global state.
+*/
+void sort_array(void** array,int len,int cmp(void* a,void* b,void* ctx),void* ctx)
+{
+    int width,i,l,r,lend,rend,k;
+    void** tmp,**src=array,**dst,**swap;
+    if(len<2)return;
+    tmp=malloc(sizeof(void*)*len);
+    dst=tmp;
+    for(width=1;width<len;width*=2)
     {
-        if(strncmp(((label*)lab->self)->name,field,64)==0)goto found;
-        lab=lab->next;
-        idx++;
+        for(i=0;i<len;i+=2*width)
+        {
+            l=i;
+            lend=i+width<len?i+width:len;
+            r=lend;
+            rend=i+2*width<len?i+2*width:len;
+            k=i;
+            while(l<lend&&r<rend)dst[k++]=cmp(src[r],src[l],ctx)<0?src[r++]:src[l++];
+            while(l<lend)dst[k++]=src[l++];
+            while(r<rend)dst[k++]=src[r++];
+        }
+        swap=src;
+        src=dst;
+        dst=swap;
     }
-    printf("KeyError: Field \"%s\" does not exist in dataset. Could not sort.\n",field);
-    return;
-    found:
-    __sortbyfield=idx;
-    __sortbyfieldtype=((label*)lab->self)->type;
-    ll=ll_to_array(&dataset->lines);
-    if(reverse)qsort(ll,ll_len(&dataset->lines),sizeof(tree_ll*),__rsortby);
-    else qsort(ll,ll_len(&dataset->lines),sizeof(tree_ll*),__sortby);
-    dataset->lines=array_to_ll(ll,ll_len(&dataset->lines));
-    free(ll);
-    return;
+    if(src!=array)memcpy(array,src,sizeof(void*)*len);
+    free(tmp);
 }
 
-double reduce(dataset* ds,char* field,void func(char field_type,void* field,double* acc,void* arg),void* arg,double init)
+/*
+Dataset caches.
+The lines of a dataset are indexed once, and each column is copied out of them (and sorted) the first time it's
+needed. Caches are shared by every thread using the dataset: columns are built outside the lock and published
+atomically, so threads working on different columns never wait for each other.
+*/
+
+/*
+A dictionary-encoded categorical column: line i has the sublabel dict[code i]. Codes are 1, 2 or 4 bytes wide, whatever
+fits the number of sublabels of the column. Lines with a label that isn't one of them get the code <labels>.
+*/
+typedef struct _code_column{
+    int width;/*Bytes per code*/
+    int labels;/*Number of sublabels*/
+    label** dict;/*Sublabel of each code*/
+    void* codes;
+}code_column;
+
+/*Code of the <i>th line of a code_column*/
+#define CODE_AT(col,i) ((col)->width==1?((unsigned char*)(col)->codes)[i]:\
+    ((col)->width==2?((unsigned short*)(col)->codes)[i]:((unsigned int*)(col)->codes)[i]))
+
+/*Allocates a code_column (as a single block) for <rows> lines of <column>*/
+code_column* __code_column(label* column,int rows)
 {
-    if(!ds||!(ds->col_labels))return 0;
-    int idx=0,i;
-    double ret=init;
-    tree_ll* lab=ds->col_labels;
-    tree_ll* line;
-    tree_ll* entry;
-    while(lab)
+    int i,labels=ll_len(&column->sublabels),width=labels<0xFF?1:(labels<0xFFFF?2:4);
+    tree_ll* lab=column->sublabels;
+    code_column* ret=malloc(sizeof(code_column)+sizeof(label*)*(labels+1)+(size_t)width*(rows+1));
+    ret->width=width;
+    ret->labels=labels;
+    ret->dict=(label**)(ret+1);
+    ret->codes=ret->dict+labels+1;
+    for(i=0;i<labels;i++)
     {
-        if(strncmp(((label*)lab->self)->name,field,64)==0)goto found;
+        ret->dict[i]=lab->self;
         lab=lab->next;
-        idx++;
-    }
-    printf("KeyError: Field \"%s\" does not exist in dataset. Could not apply reduction.\n",field);
-    return 0;
-    found:
-    line=ds->lines;
-    while(line)
-    {
-        entry=(tree_ll*)line->self;
-        for(i=0;i<idx;i++)entry=entry->next;
-        func(((label*)lab->self)->type,entry->self,&ret,arg);
-        line=line->next;
     }
+    ret->dict[labels]=NULL;
     return ret;
 }
 
-/*
-Reduction function for counting elements with a certain label
-field_type=LABEL_CAT
-arg=label* acc=0
-*/
-void r_count(char field_type,void* field,double* acc,void* arg)
+/*Sets the code of the <i>th line (-1 for labels that aren't in the dictionary)*/
+void __code_set(code_column* col,int i,int code)
 {
-    if(field_type!=LABEL_CAT)return;
-    *acc+=field==arg?1:0;
+    if(code<0)code=col->labels;
+    if(col->width==1)((unsigned char*)col->codes)[i]=code;
+    else if(col->width==2)((unsigned short*)col->codes)[i]=code;
+    else ((unsigned int*)col->codes)[i]=code;
 }
 
-/*
-Reduction function for summing all elements
-field_type=LABEL_NUM
-arg=NULL acc=0
-*/
-void r_sum(char field_type,void* field,double* acc,void* arg)
+/*Sets the bits of the lines with code <code> on <mask>*/
+void mask_code(code_column* col,int len,int code,unsigned long long* mask)
 {
-    if(field_type!=LABEL_NUM)return;
-    *acc+=*(double*)field;
+    if(col->width==1)mask_eq8(col->codes,len,code,mask);
+    else if(col->width==2)mask_eq16(col->codes,len,code,mask);
+    else mask_eq(col->codes,len,code,mask);
+}
+
+/*Sets the bits of the lines whose codes are on the bitset <subset> on <in>, and those of the other lines (but unknown labels) on <out>*/
+void mask_codes_in(code_column* col,int len,unsigned long long* subset,unsigned long long* in,unsigned long long* out)
+{
+    int i,code;
+    memset(in,0,sizeof(unsigned long long)*MASK_WORDS(len));
+    memset(out,0,sizeof(unsigned long long)*MASK_WORDS(len));
+    for(i=0;i<len;i++)
+        if((code=CODE_AT(col,i))<col->labels)((subset[code/64]>>(code%64))&1?in:out)[i/64]|=1ULL<<(i%64);
+}
+
+/*A numerical column, stored at the precision of its label*/
+typedef struct _num_column{
+    char precision;/*PRECISION_DOUBLE or PRECISION_FLOAT*/
+    void* values;
+}num_column;
+
+/*Value of the <i>th line of a num_column*/
+#define VALUE_AT(col,i) ((col)->precision==PRECISION_FLOAT?(double)((float*)(col)->values)[i]:((double*)(col)->values)[i])
+
+/*Allocates a num_column (as a single block) for <rows> lines at <precision>*/
+num_column* __num_column(char precision,int rows)
+{
+    size_t width=precision==PRECISION_FLOAT?sizeof(float):sizeof(double);
+    num_column* ret=malloc(sizeof(num_column)+sizeof(double)+width*(rows+1));
+    ret->precision=precision==PRECISION_FLOAT?PRECISION_FLOAT:PRECISION_DOUBLE;
+    /*Past the header, aligned for doubles*/
+    ret->values=(double*)(ret+1)+1;
+    return ret;
+}
+
+void __value_set(num_column* col,int i,double value)
+{
+    if(col->precision==PRECISION_FLOAT)((float*)col->values)[i]=value;
+    else ((double*)col->values)[i]=value;
+}
+
+/*The biggest float that isn't above <threshold>*/
+float __float_floor(double threshold)
+{
+    float ret=threshold;
+    return ret>threshold?nextafterf(ret,-INFINITY):ret;
 }
 
 /*
-Reduction function for calculating the sum of all squared deviations from <double* arg>
-field_type=LABEL_NUM
-arg=&double acc=0
+Returns the threshold for classifying (double) lines by a split made at <threshold> on <col>.
+Single precision columns compare their values rounded to floats, so a double value goes to the same side as its
+rounded value only if the threshold is the biggest double that rounds down to (at most) the same float.
 */
-void r_dev(char field_type,void* field,double* acc,void* arg)
+double num_threshold(num_column* col,double threshold)
 {
-    if(field_type!=LABEL_NUM)return;
-    *acc+=((*(double*)field)-*(double*)arg)*((*(double*)field)-*(double*)arg);
+    float f,next;
+    double ret;
+    if(col->precision!=PRECISION_FLOAT||isnan(threshold))return threshold;
+    f=__float_floor(threshold);
+    if(isinf(f))return f;
+    next=nextafterf(f,INFINITY);
+    /*Halfway to the next float (exact as a double), less one step if that already rounds up*/
+    ret=isinf(next)?f+(f-(double)nextafterf(f,-INFINITY))/2:((double)f+next)/2;
+    return (float)ret>f?nextafter(ret,-INFINITY):ret;
 }
 
-double mean(dataset* ds,char* field)
+/*Sets the bits of the lines with values <= <threshold> on <mask>*/
+void mask_num(num_column* col,int len,double threshold,unsigned long long* mask)
 {
-    if(!ds||!(ds->col_labels))return 0;
-    int idx=0;
-    tree_ll* lab=ds->col_labels;
-    while(lab)
+    if(col->precision==PRECISION_FLOAT)mask_le_f32(col->values,len,__float_floor(threshold),mask);
+    else mask_le(col->values,len,threshold,mask);
+}
+
+typedef struct _dataset_cache{
+    pthread_mutex_t lock;/*Held while publishing a column*/
+    int rows,cols;
+    label** columns;/*Column labels, by index*/
+    tree_ll** lines;/*Entries of each line, by line index*/
+    num_column** values;/*Numerical columns*/
+    code_column** codes;/*Categorical columns, dictionary-encoded*/
+    int** perm;/*Line indexes sorted by each column*/
+    unsigned long long** rowsets;/*Categorical columns as one bitmap per sublabel (see cache_label_rows)*/
+    column_stats* stats;/*See dataset_stats*/
+    /*Subsets made by a split take the columns their parent has cached on first access to them (see __cache_link)*/
+    struct _dataset_cache* parent;
+    int* src;/*Parent line of each line*/
+    int* map;/*Index of each parent line on the subset that has it*/
+    unsigned long long* mask;/*Parent lines that are on this subset (NULL: the ones whose index on <map> isn't -1)*/
+}dataset_cache;
+
+void __cache_clear(dataset_cache* c)
+{
+    int i;
+    for(i=0;i<c->cols;i++)
     {
-        if(strncmp(((label*)lab->self)->name,field,64)==0)goto found;
-        lab=lab->next;
-        idx++;
+        free(c->values[i]);
+        free(c->codes[i]);
+        free(c->perm[i]);
+        free(c->rowsets[i]);
     }
-    printf("KeyError: Field \"%s\" does not exist in dataset. Could not calculate mean.\n",field);
-    return 0;
-    found:
-    return reduce(ds,field,r_sum,NULL,0)/ll_len(&ds->lines);
+    free(c->columns);
+    free(c->lines);
+    free(c->values);
+    free(c->codes);
+    free(c->perm);
+    free(c->rowsets);
+    free(c->stats);
 }
 
-double variance(dataset* ds,char* field)
+/*Indexes the lines and columns of <ds> (the columns themselves are filled in later)*/
+void __cache_index(dataset_cache* c,dataset* ds)
 {
-    if(!ds||!(ds->col_labels))return 0;
-    int idx=0,len;
-    double mean=0;
-    tree_ll* lab=ds->col_labels;
-    while(lab)
+    int i;
+    tree_ll* cur;
+    c->rows=ll_len(&ds->lines);
+    c->cols=ll_len(&ds->col_labels);
+    c->columns=malloc(sizeof(label*)*(c->cols?c->cols:1));
+    c->lines=malloc(sizeof(tree_ll*)*(c->rows?c->rows:1));
+    c->values=calloc(c->cols?c->cols:1,sizeof(num_column*));
+    c->codes=calloc(c->cols?c->cols:1,sizeof(code_column*));
+    c->perm=calloc(c->cols?c->cols:1,sizeof(int*));
+    c->rowsets=calloc(c->cols?c->cols:1,sizeof(unsigned long long*));
+    c->stats=NULL;
+    cur=ds->col_labels;
+    for(i=0;i<c->cols;i++)
     {
-        if(strncmp(((label*)lab->self)->name,field,64)==0)goto found;
-        lab=lab->next;
-        idx++;
+        c->columns[i]=cur->self;
+        cur=cur->next;
+    }
+    cur=ds->lines;
+    for(i=0;i<c->rows;i++)
+    {
+        c->lines[i]=cur->self;
+        cur=cur->next;
     }
-    printf("KeyError: Field \"%s\" does not exist in dataset. Could not calculate variance.\n",field);
-    return 0;
-    found:
-    len=ll_len(&ds->lines);
-    mean=reduce(ds,field,r_sum,NULL,0)/len;
-    return reduce(ds,field,r_dev,&mean,0)/len;
 }
 
-double std_dev(dataset* ds,char* field)
+dataset_cache* __cache_new(dataset* ds)
 {
-    return sqrt(variance(ds,field));
+    dataset_cache* c=malloc(sizeof(dataset_cache));
+    pthread_mutex_init(&c->lock,NULL);
+    __cache_index(c,ds);
+    c->parent=NULL;
+    c->src=c->map=NULL;
+    c->mask=NULL;
+    return c;
 }
 
-double class_entropy(dataset* ds,char* field)
+void dataset_changed(dataset* ds)
 {
-    if(!ds||!(ds->col_labels))return 0;
-    int len;
-    double entropy=0,p;
-    tree_ll* lab=ds->col_labels,*clab;
-    while(lab)
-    {
-        if(strncmp(((label*)lab->self)->name,field,64)==0)goto found;
-        lab=lab->next;
+    if(!ds||!ds->cache)return;
+    __cache_clear(ds->cache);
+    pthread_mutex_destroy(&ds->cache->lock);
+    free(ds->cache);
+    ds->cache=NULL;
+}
+
+void set_precision(dataset* ds,char* field,char precision)
+{
+    if(!ds||!ds->col_labels)return;
+    tree_ll* cur;
+    label* lab;
+    if(field&&!select_label(ds->col_labels,field))
+    {
+        printf("KeyError: Field \"%s\" does not exist in dataset. Could not set precision.\n",field);
+        return;
     }
-    printf("KeyError: Field \"%s\" does not exist in dataset. Could not calculate class entropy.\n",field);
-    return 0;
-    found:
-    if(((label*)lab->self)->type!=LABEL_CAT)return 0;
-    len=ll_len(&ds->lines);
-    clab=((label*)lab->self)->sublabels;
-    while(clab)
+    for(cur=ds->col_labels;cur;cur=cur->next)
     {
-        p=reduce(ds,field,r_count,clab->self,0)/len;
-        entropy+=p==0?0:p*log(p);
-        clab=clab->next;
+        lab=cur->self;
+        if(lab->type==LABEL_NUM&&(!field||!strncmp(lab->name,field,64)))lab->precision=precision;
     }
-    return -entropy;
+    /*Cached columns are stored at the old precision*/
+    dataset_changed(ds);
 }
-double attribute_entropy(dataset* ds,char* field,char* classfield)
+
+/*
+Returns the cache of <ds>, building it if needed.
+Other threads may be reading the cache, so it's never rebuilt in place: changes to the lines must go through
+dataset_changed, which drops it.
+*/
+dataset_cache* get_cache(dataset* ds)
 {
-    if(!ds||!(ds->col_labels))return 0;
-    int len,idx=0;
-    double entropy=0;
-    tree_ll* lab=ds->col_labels,*clab;
-    dataset* sub;
-    f_namefilter conf;
-    while(lab)
-    {
-        if(strncmp(((label*)lab->self)->name,field,64)==0)goto found;
-        lab=lab->next;
-        idx++;
-    }
-    printf("KeyError: Field \"%s\" does not exist in dataset. Could not calculate attribute entropy.\n",field);
-    return 0;
-    found:
-    len=ll_len(&ds->lines);
-    if(((label*)lab->self)->type==LABEL_CAT)
+    dataset_cache* c=__atomic_load_n(&ds->cache,__ATOMIC_ACQUIRE),*none=NULL;
+    if(!c)
     {
-        clab=((label*)lab->self)->sublabels;
-        while(clab)
+        c=__cache_new(ds);
+        if(!__atomic_compare_exchange_n(&ds->cache,&none,c,0,__ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE))
         {
-            conf.field_index=idx;
-            conf.target=clab->self;
-            sub=filter_dataset(ds,f_by_name,&conf);
-
-            entropy+=(ll_len(&sub->lines)/(double)len)*class_entropy(sub,classfield);
-
-            ll_free(&sub->lines);
-            free(sub);
-            clab=clab->next;
+            /*Another thread got there first*/
+            __cache_clear(c);
+            pthread_mutex_destroy(&c->lock);
+            free(c);
+            c=none;
         }
     }
-    return entropy;
+    return c;
 }
-double attribute_num_entropy(dataset* ds,char* field,char* classfield,double threshold)
+
+/*Stores <column> on <slot> unless another thread already did, in which case <column> is dropped. Returns the stored one*/
+void* __cache_publish(dataset_cache* c,void** slot,void* column)
 {
-    if(!ds||!(ds->col_labels))return 0;
-    int len,idx=0;
-    double entropy=0;
-    tree_ll* lab=ds->col_labels;
-    dataset* sub;
-    f_numberfilter conf;
-    while(lab)
-    {
-        if(strncmp(((label*)lab->self)->name,field,64)==0)goto found;
-        lab=lab->next;
-        idx++;
-    }
-    printf("KeyError: Field \"%s\" does not exist in dataset. Could not calculate attribute entropy.\n",field);
-    return 0;
-    found:
-    len=ll_len(&ds->lines);
-    if(((label*)lab->self)->type==LABEL_NUM)
+    void* cur;
+    pthread_mutex_lock(&c->lock);
+    if((cur=*slot))free(column);
+    else __atomic_store_n(slot,(cur=column),__ATOMIC_RELEASE);
+    pthread_mutex_unlock(&c->lock);
+    return cur;
+}
+
+/*Returns the entry of every line at column <col>*/
+void** __cache_entries(dataset_cache* c,int col)
+{
+    int i,j;
+    tree_ll* entry;
+    void** ret=malloc(sizeof(void*)*(c->rows?c->rows:1));
+    for(i=0;i<c->rows;i++)
     {
-        conf.field_index=idx;
-        conf.target=threshold;
-        conf.bt=0;
-        sub=filter_dataset(ds,f_by_number,&conf);
-        entropy+=(ll_len(&sub->lines)/(double)len)*class_entropy(sub,classfield);
-        ll_free(&sub->lines);
-        free(sub);
-        conf.bt=1;
-        sub=filter_dataset(ds,f_by_number,&conf);
-        entropy+=(ll_len(&sub->lines)/(double)len)*class_entropy(sub,classfield);
-        ll_free(&sub->lines);
-        free(sub);
+        entry=c->lines[i];
+        for(j=0;j<col;j++)entry=entry->next;
+        ret[i]=entry->self;
     }
-    return entropy;
+    return ret;
 }
 
-double optimize_threshold(dataset* ds,char* field,char* classfield)
+/*Kinds of cached columns*/
+#define COLUMN_VALUES 0
+#define COLUMN_CODES 1
+#define COLUMN_PERM 2
+
+void** __cache_slot(dataset_cache* c,int col,char kind)
 {
-    if(!ds||!field||!classfield||!(ds->col_labels)||ll_len(&ds->lines)==0)return 0;
-    int pos,i,idx=0,dir=1,len=ll_len(&ds->lines);
-    double threshold=0,pt,ent,pent=__DBL_MAX__;
-    tree_ll* lab=ds->col_labels,*line;
-    while(lab)
+    if(kind==COLUMN_VALUES)return (void**)&c->values[col];
+    if(kind==COLUMN_CODES)return (void**)&c->codes[col];
+    return (void**)&c->perm[col];
+}
+
+void* __derive_column(dataset_cache* c,int col,char kind);
+
+/*
+Returns the <col>th column of kind <kind> of the parent of <c>, derived (and cached) in turn from its own parent if it
+doesn't have it yet, or NULL if no ancestor has it cached.
+*/
+void* __parent_column(dataset_cache* c,int col,char kind)
+{
+    dataset_cache* p=c->parent;
+    void** slot,*ret;
+    if(!p)return NULL;
+    slot=__cache_slot(p,col,kind);
+    if((ret=__atomic_load_n(slot,__ATOMIC_ACQUIRE)))return ret;
+    if(!(ret=__derive_column(p,col,kind)))return NULL;
+    return __cache_publish(p,slot,ret);
+}
+
+/*
+Builds the <col>th column of kind <kind> of <c> from the one of its parent, or returns NULL if it can't be taken from
+there. Sorted orders are filtered rather than sorted again, so every subset of a dataset shares the work of sorting it.
+*/
+void* __derive_column(dataset_cache* c,int col,char kind)
+{
+    void* from=__parent_column(c,col,kind);
+    num_column* values;
+    code_column* codes;
+    int i,k,r,*perm;
+    if(!from)return NULL;
+    if(kind==COLUMN_VALUES)
     {
-        if(strncmp(((label*)lab->self)->name,field,64)==0)goto found;
-        lab=lab->next;
-        idx++;
+        values=__num_column(((num_column*)from)->precision,c->rows);
+        for(i=0;i<c->rows;i++)__value_set(values,i,VALUE_AT((num_column*)from,c->src[i]));
+        return values;
     }
-    printf("KeyError: Field \"%s\" does not exist in dataset. Could not optimize threshold.\n",field);
-    return 0;
-    found:
-    if(((label*)lab->self)->type==LABEL_NUM)
+    if(kind==COLUMN_CODES)
     {
-        sort_by(ds,((label*)lab->self)->name,0);
-        pos=ll_len(&ds->lines)/2;
-        /*We select the line at the desired position*/
-        line=ds->lines;
-        for(i=0;i<pos;i++)line=line->next;
-        /*And the attribute we are optimizing*/
-        line=line->self;
-        for(i=0;i<idx;i++)line=line->next;
-        pt=*(double*)line->self;
-        pent=attribute_num_entropy(ds,field,classfield,pt);
-        while(dir>=-1&&pos+dir>0&&pos+dir<len)
-        {
-            pos+=dir;
-            /*We select the line at the desired position*/
-            line=ds->lines;
-            for(i=0;i<pos;i++)line=line->next;
-            /*And the attribute we are optimizing*/
-            line=line->self;
-            for(i=0;i<idx;i++)line=line->next;
-            threshold=*(double*)line->self;
-            ent=attribute_num_entropy(ds,field,classfield,threshold);
-            if(ent>pent)
-            {
-                dir-=2;
-                pos+=dir;
-            }
-            else
-            {
-                pent=ent;
-                pt=threshold;
-            }
-        }
+        codes=__code_column(c->columns[col],c->rows);
+        for(i=0;i<c->rows;i++)__code_set(codes,i,CODE_AT((code_column*)from,c->src[i]));
+        return codes;
     }
-    return threshold;
-}
-
-dataset* filter_dataset(dataset* ds,char func(tree_ll* line,void* arg),void* arg)
-{
-    if(!ds||!ds->col_labels||!ds->lines)return NULL;
-    dataset* ret=malloc(sizeof(dataset));
-    tree_ll* cur=ds->lines;
-    ret->col_labels=ds->col_labels;
-    ret->lines=NULL;
-    while(cur)
+    perm=malloc(sizeof(int)*(c->rows?c->rows:1));
+    for(i=0,k=0;i<c->parent->rows;i++)
     {
-        if(func(cur->self,arg))ll_push(&ret->lines,cur->self);
-        cur=cur->next;
+        r=((int*)from)[i];
+        if(c->mask?(c->mask[r/64]>>(r%64))&1:c->map[r]>=0)perm[k++]=c->map[r];
     }
-    return ret;
+    return perm;
 }
 
-char f_by_name(tree_ll* line,void* arg)
+/*Returns the <col>th (numerical) column of <ds>*/
+num_column* cache_values(dataset* ds,int col)
 {
+    dataset_cache* c=get_cache(ds);
+    num_column* ret=__atomic_load_n(&c->values[col],__ATOMIC_ACQUIRE);
+    void** entries;
     int i;
-    for(i=0;i<((f_namefilter*)arg)->field_index;i++)line=line->next;
-    return line->self==((f_namefilter*)arg)->target;
+    if(ret)return ret;
+    if((ret=__derive_column(c,col,COLUMN_VALUES)))return __cache_publish(c,(void**)&c->values[col],ret);
+    entries=__cache_entries(c,col);
+    ret=__num_column(c->columns[col]->precision,c->rows);
+    for(i=0;i<c->rows;i++)__value_set(ret,i,*(double*)entries[i]);
+    free(entries);
+    return __cache_publish(c,(void**)&c->values[col],ret);
 }
 
-char f_by_number(tree_ll* line,void* arg)
+/*A sublabel and its index, for looking sublabels up by address*/
+typedef struct _label_ref{
+    void* lab;
+    int idx;
+}label_ref;
+
+int __label_refcmp(const void* a,const void* b)
 {
-    int i;
-    char r;
-    for(i=0;i<((f_numberfilter*)arg)->field_index;i++)line=line->next;
-    r=(*((double*)line->self)<=((f_numberfilter*)arg)->target);
-    if(((f_numberfilter*)arg)->bt)r=!r;
-    return r;
+    void *va=((label_ref*)a)->lab,*vb=((label_ref*)b)->lab;
+    return (va>vb)?1:(va==vb?0:-1);
 }
 
-double chi_squared(dataset* root,dataset** children,int len,label* classlabel)
+/*Returns the sublabels of <column> sorted by address, so their indexes can be found with __label_lookup*/
+label_ref* __label_table(label* column,int* len)
 {
-    if(!root||!children||classlabel->type!=LABEL_CAT)return 0;
     int i;
-    tree_ll* lab;
-    double ret=0,count,expected;
-    for(i=0;i<len;i++)
+    tree_ll* lab=column->sublabels;
+    label_ref* ret;
+    *len=ll_len(&column->sublabels);
+    ret=malloc(sizeof(label_ref)*(*len?*len:1));
+    for(i=0;i<*len;i++)
     {
-        if(!children[i])return 0;
-        lab=classlabel->sublabels;
-        expected=reduce(root,classlabel->name,r_count,lab->self,0)*(1/(double)len);
-        while(lab)
-        {
-            count=reduce(children[i],classlabel->name,r_count,lab->self,0);
-            ret+=((count-expected)*(count-expected))/expected;
-            lab=lab->next;
-        }
+        ret[i].lab=lab->self;
+        ret[i].idx=i;
+        lab=lab->next;
     }
+    qsort(ret,*len,sizeof(label_ref),__label_refcmp);
     return ret;
 }
 
-dataset* sample_dataset(dataset* ds,int len,char* classfield)
+/*Returns the index of sublabel <lab> (or -1)*/
+int __label_lookup(label_ref* table,int len,void* lab)
 {
-    if(!ds||len==0)return NULL;
-    label* classlabel=select_label(ds->col_labels,classfield);
-    if(!classlabel)return NULL;
-    char* selected;
-    int cur,subs=ll_len(&classlabel->sublabels),olen=ll_len(&ds->lines),tlen,clen,slen,sel,i;
-    f_namefilter conf;
-    conf.field_index=select_label_index(ds->col_labels,classfield);
-    tree_ll* cval,*line;
-    dataset* ret=malloc(sizeof(dataset));
-    ret->col_labels=ds->col_labels;
-    ret->lines=NULL;
-    dataset* subset;
+    label_ref key,*found;
+    key.lab=lab;
+    found=bsearch(&key,table,len,sizeof(label_ref),__label_refcmp);
+    return found?found->idx:-1;
+}
 
-    cval=classlabel->sublabels;
-    for(cur=0;cur<subs;cur++)
-    {
-        conf.target=cval->self;
-        subset=filter_dataset(ds,f_by_name,&conf);
-        slen=ll_len(&subset->lines);
-        clen=0;
-        selected=calloc(slen,1);
-        tlen=len*((double)slen/(double)olen);
-        while(clen<tlen)
-        {
-            while(selected[(sel=rand()%slen)]);
-            line=subset->lines;
-            for(i=0;i<sel;i++)line=line->next;
-            ll_push(&ret->lines,line->self);
-            selected[sel]=1;
-            clen++;
-        }
-        free(selected);
-        ll_free(&subset->lines);
-        free(subset);
-        cval=cval->next;
-    }
-    return ret;
+/*Returns the <col>th (categorical) column of <ds>, dictionary-encoded*/
+code_column* cache_codes(dataset* ds,int col)
+{
+    dataset_cache* c=get_cache(ds);
+    code_column* ret=__atomic_load_n(&c->codes[col],__ATOMIC_ACQUIRE);
+    void** entries;
+    label_ref* table;
+    int i,len;
+    if(ret)return ret;
+    if((ret=__derive_column(c,col,COLUMN_CODES)))return __cache_publish(c,(void**)&c->codes[col],ret);
+    entries=__cache_entries(c,col);
+    table=__label_table(c->columns[col],&len);
+    ret=__code_column(c->columns[col],c->rows);
+    for(i=0;i<c->rows;i++)__code_set(ret,i,__label_lookup(table,len,entries[i]));
+    free(table);
+    free(entries);
+    return __cache_publish(c,(void**)&c->codes[col],ret);
 }
 
-label* most_frequent_class(tree_node* root,dataset* ds,char* classfield)
+/*Caches every column of <ds> that isn't cached yet, walking each line only once (instead of once per column)*/
+void cache_fill(dataset* ds)
 {
-    if(!root||!ds)return NULL;
-    label* classlabel=select_label(ds->col_labels,classfield),*result;
-    unsigned int len=ll_len(&classlabel->sublabels),occurences[len],i,imax=0,max=0;
-    for(i=0;i<len;i++)occurences[i]=0;
-    tree_ll* line=ds->lines;
-    foreach(line,{
-        result=classify(root,line->self,ds->col_labels);
-        if(result)
+    dataset_cache* c=get_cache(ds);
+    int i,j,*lens=calloc(c->cols+1,sizeof(int));
+    num_column** values=calloc(c->cols+1,sizeof(num_column*));
+    code_column** codes=calloc(c->cols+1,sizeof(code_column*));
+    label_ref** tables=calloc(c->cols+1,sizeof(label_ref*));
+    tree_ll* entry;
+    void* derived,**slot;
+    char kind;
+    for(j=0;j<c->cols;j++)
+    {
+        /*Columns a split subset can take from its parent aren't read from the lines*/
+        kind=c->columns[j]->type==LABEL_NUM?COLUMN_VALUES:COLUMN_CODES;
+        slot=__cache_slot(c,j,kind);
+        if(!__atomic_load_n(slot,__ATOMIC_ACQUIRE)&&(derived=__derive_column(c,j,kind)))__cache_publish(c,slot,derived);
+        if(c->columns[j]->type==LABEL_NUM&&!__atomic_load_n(&c->values[j],__ATOMIC_ACQUIRE))
+            values[j]=__num_column(c->columns[j]->precision,c->rows);
+        else if(c->columns[j]->type==LABEL_CAT&&!__atomic_load_n(&c->codes[j],__ATOMIC_ACQUIRE))
         {
-            occurences[select_label_index(classlabel->sublabels,result->name)]++;
+            codes[j]=__code_column(c->columns[j],c->rows);
+            tables[j]=__label_table(c->columns[j],&lens[j]);
         }
-    });
-    for(i=0;i<len;i++)
+    }
+    for(i=0;i<c->rows;i++)
     {
-        if(occurences[i]>max)
+        entry=c->lines[i];
+        for(j=0;j<c->cols&&entry;j++)
         {
-            imax=i;
-            max=occurences[i];
+            if(values[j])__value_set(values[j],i,*(double*)entry->self);
+            else if(codes[j])__code_set(codes[j],i,__label_lookup(tables[j],lens[j],entry->self));
+            entry=entry->next;
         }
     }
-    return select_label_by_index(classlabel->sublabels,imax);
+    for(j=0;j<c->cols;j++)
+    {
+        if(values[j])__cache_publish(c,(void**)&c->values[j],values[j]);
+        if(codes[j])__cache_publish(c,(void**)&c->codes[j],codes[j]);
+        free(tables[j]);
+    }
+    free(lens);
+    free(values);
+    free(codes);
+    free(tables);
 }
 
 /*
-Trees
+Returns the <col>th (categorical) column of <ds> as one bitmap per sublabel: the lines with the <k>th sublabel are
+the bitmap starting at word k*MASK_WORDS(lines).
 */
+unsigned long long* cache_label_rows(dataset* ds,int col)
+{
+    dataset_cache* c=get_cache(ds);
+    unsigned long long* ret=__atomic_load_n(&c->rowsets[col],__ATOMIC_ACQUIRE);
+    int i,code,words=MASK_WORDS(c->rows);
+    code_column* codes;
+    if(ret)return ret;
+    codes=cache_codes(ds,col);
+    ret=calloc(codes->labels*words+1,sizeof(unsigned long long));
+    for(i=0;i<c->rows;i++)if((code=CODE_AT(codes,i))<codes->labels)ret[code*words+i/64]|=1ULL<<(i%64);
+    return __cache_publish(c,(void**)&c->rowsets[col],ret);
+}
 
-void fit_tree(tree_node** root,dataset* ds,double chi_square_significance_limit,char* classfield)
+/*Stable merge sort of the indexes in <idx> by <keys>*/
+void sort_indexes(int* idx,int len,double* keys)
 {
-    if(!root||!ds)return;
-    int i=0,mi,len;
-    tree_ll* classlabel=ds->col_labels;
-    while(classlabel)
-    {
-        if(strncmp(((label*)classlabel->self)->name,classfield,64)==0)goto found;
-        classlabel=classlabel->next;
-    }
-    printf("KeyError: Field \"%s\" does not exist in dataset. Could not fit tree.\n",classfield);
-    return;
-    label* l=NULL;
-    double entropy,thresh,pt;
-    double gain,maxgain=0;
-    tree_ll* lab=ds->col_labels;
-    dataset** subsets;
-    tree_ll* working;
-    f_numberfilter nuconf;
-    f_namefilter naconf;
-    found:
-    l=NULL;
-    entropy=class_entropy(ds,classfield);
-    lab=ds->col_labels;
-    while(lab&&entropy)
+    int width,i,l,r,lend,rend,k;
+    int* tmp,*src=idx,*dst,*swap;
+    if(len<2)return;
+    tmp=malloc(sizeof(int)*len);
+    dst=tmp;
+    for(width=1;width<len;width*=2)
     {
-        if(strcmp(((label*)lab->self)->name,classfield))
+        for(i=0;i<len;i+=2*width)
         {
-            if(((label*)lab->self)->type==LABEL_NUM)
-            {
-                thresh=optimize_threshold(ds,((label*)lab->self)->name,classfield);
-                gain=entropy-attribute_num_entropy(ds,((label*)lab->self)->name,classfield,thresh);
-            }
-            else
-            {
-                gain=entropy-attribute_entropy(ds,((label*)lab->self)->name,classfield);
-            }
-            if(gain>maxgain)
-            {
-                l=((label*)lab->self);
-                pt=thresh;
-                maxgain=gain;
-                mi=i;
-            }
+            l=i;
+            lend=i+width<len?i+width:len;
+            r=lend;
+            rend=i+2*width<len?i+2*width:len;
+            k=i;
+            while(l<lend&&r<rend)dst[k++]=keys[src[r]]<keys[src[l]]?src[r++]:src[l++];
+            while(l<lend)dst[k++]=src[l++];
+            while(r<rend)dst[k++]=src[r++];
         }
-        i++;
-        lab=lab->next;
-    }
-    *root=malloc(sizeof(tree_node));
-    if(!l||!entropy)
-    {
-        /*We choose the biggest count and set ourselves as a leaf node*/
-        goto leaf;
+        swap=src;
+        src=dst;
+        dst=swap;
     }
-    if(l->type==LABEL_NUM)
+    if(src!=idx)memcpy(idx,src,sizeof(int)*len);
+    free(tmp);
+}
+
+int __namecmp(void* a,void* b,void* ctx)
+{
+    return strncmp(((label*)a)->name,((label*)b)->name,64);
+}
+
+/*
+Returns the line indexes of <ds> sorted by its <col>th column (by value for numerical columns, by name for
+categorical ones). Ties keep the order of the lines.
+*/
+int* cache_perm(dataset* ds,int col)
+{
+    dataset_cache* c=get_cache(ds);
+    int* ret=__atomic_load_n(&c->perm[col],__ATOMIC_ACQUIRE),i,code,len;
+    code_column* codes;
+    num_column* values;
+    double* keys,*rank;
+    void** sublabels;
+    tree_ll* lab;
+    if(ret)return ret;
+    if((ret=__derive_column(c,col,COLUMN_PERM)))return __cache_publish(c,(void**)&c->perm[col],ret);
+    ret=malloc(sizeof(int)*(c->rows?c->rows:1));
+    for(i=0;i<c->rows;i++)ret[i]=i;
+    if(c->columns[col]->type==LABEL_NUM)
     {
-        (*root)->attribute=l;
-        (*root)->partition=pt;
-        (*root)->subtrees=NULL;
-        subsets=malloc(sizeof(dataset*)*2);
-        nuconf.bt=0;
-        nuconf.field_index=mi;
-        nuconf.target=pt;
-        subsets[0]=filter_dataset(ds,f_by_number,&nuconf);
-        nuconf.bt=1;
-        subsets[1]=filter_dataset(ds,f_by_number,&nuconf);
-        if(ll_len(&subsets[0]->lines)==0||ll_len(&subsets[1]->lines)==0)
-        {
-            ll_free(&subsets[0]->lines);
-            ll_free(&subsets[1]->lines);
-            free(subsets[0]);
-            free(subsets[1]);
-            goto leaf;
-        }
-
-        /*Chi-squared test*/
-        if(chi_squared(ds,subsets,2,classlabel->self)<chi_square_significance_limit)
-        {
-            /*If it doesn't pass the test, we choose the biggest count and set ourselves as a leaf node*/
-            ll_free(&subsets[0]->lines);
-            ll_free(&subsets[1]->lines);
-            free(subsets[0]);
-            free(subsets[1]);
-            goto leaf;
-        }
+        values=cache_values(ds,col);
+        if(values->precision!=PRECISION_FLOAT)sort_indexes(ret,c->rows,values->values);
         else
         {
-            /*If the division is not statistically insignificant, we can keep it*/
-            ll_push(&(*root)->subtrees,malloc(sizeof(tree_node*)));
-            fit_tree((tree_node**)&(*root)->subtrees->self,subsets[0],chi_square_significance_limit,classfield);
-            ll_push(&(*root)->subtrees,malloc(sizeof(tree_node*)));
-            fit_tree((tree_node**)&(*root)->subtrees->next->self,subsets[1],chi_square_significance_limit,classfield);
-            ll_free(&subsets[0]->lines);
-            ll_free(&subsets[1]->lines);
-            free(subsets[0]);
-            free(subsets[1]);
+            keys=malloc(sizeof(double)*(c->rows?c->rows:1));
+            for(i=0;i<c->rows;i++)keys[i]=VALUE_AT(values,i);
+            sort_indexes(ret,c->rows,keys);
+            free(keys);
         }
     }
     else
     {
-        (*root)->attribute=l;
-        (*root)->partition=0;
-        (*root)->subtrees=NULL;
-        len=ll_len(&l->sublabels);
-        lab=l->sublabels;
-        subsets=malloc(sizeof(dataset*)*len);
-        naconf.field_index=mi;
+        /*Sublabels are ranked by name once, then the lines are sorted by rank*/
+        len=ll_len(&c->columns[col]->sublabels);
+        sublabels=malloc(sizeof(void*)*(len?len:1));
+        rank=malloc(sizeof(double)*(len?len:1));
+        lab=c->columns[col]->sublabels;
         for(i=0;i<len;i++)
         {
-            naconf.target=lab->self;
-            subsets[i]=filter_dataset(ds,f_by_name,&naconf);
-            if(ll_len(&subsets[i]->lines)==0)
-            {
-                len=i;
-                for(i=0;i<=len;i++)
-                {
-                    ll_free(&subsets[i]->lines);
-                    free(subsets[i]);
-                }
-                goto leaf;
-            }
+            sublabels[i]=lab->self;
             lab=lab->next;
         }
-        /*Chi-squared test*/
-        if(chi_squared(ds,subsets,len,classlabel->self)<chi_square_significance_limit)
-        {
-            /*If it doesn't pass the test, we choose the biggest count and set ourselves as a leaf node*/
-            for(i=0;i<len;i++)
-            {
-                ll_free(&subsets[i]->lines);
-                free(subsets[i]);
-            }
-            goto leaf;
-        }
-        else
-        {
-            /*If the division is not statistically insignificant, we can keep it*/
-            working=ll_push(&(*root)->subtrees,malloc(sizeof(tree_node*)));
-            fit_tree((tree_node**)&working->self,subsets[0],chi_square_significance_limit,classfield);
-            ll_free(&subsets[0]->lines);
-            free(subsets[0]);
-            for(i=1;i<len;i++)
-            {
-                working=ll_push(&working,malloc(sizeof(tree_node*)));
-                fit_tree((tree_node**)&working->self,subsets[i],chi_square_significance_limit,classfield);
-                ll_free(&subsets[i]->lines);
-                free(subsets[i]);
-            }
-        }
-    }
-    return;
-    leaf:
-    lab=((label*)classlabel->self)->sublabels;
-    mi=0;
-    while(lab)
-    {
-        i=reduce(ds,classfield,r_count,lab->self,0);
-        if(i>mi)
-        {
-            mi=i;
-            l=lab->self;
-        }
-        lab=lab->next;
+        sort_array(sublabels,len,__namecmp,NULL);
+        for(i=0;i<len;i++)rank[sublabel_index(c->columns[col]->sublabels,sublabels[i])]=i;
+        codes=cache_codes(ds,col);
+        keys=malloc(sizeof(double)*(c->rows?c->rows:1));
+        for(i=0;i<c->rows;i++)keys[i]=(code=CODE_AT(codes,i))<codes->labels?rank[code]:-1;
+        sort_indexes(ret,c->rows,keys);
+        free(keys);
+        free(rank);
+        free(sublabels);
     }
-    (*root)->attribute=l;
-    (*root)->partition=0;
-    (*root)->subtrees=NULL;
+    return __cache_publish(c,(void**)&c->perm[col],ret);
 }
 
-void fit_random_tree(tree_node** root,dataset* ds,double chi_square_significance_limit,char* classfield)
+/*
+Carries the cached columns of <parent> over to <child>, whose <len> lines are the parent's lines <src>, right away (for
+subsets that may outlive their parent).
+*/
+void __cache_derive(dataset* parent,dataset* child,int* src,int len)
 {
-    if(!root||!ds)return;
-    int i=0,mi,len;
-    tree_ll* classlabel=ds->col_labels;
-    while(classlabel)
+    dataset_cache* pc=__atomic_load_n(&parent->cache,__ATOMIC_ACQUIRE),*c;
+    int i,j;
+    if(!pc||!len)return;
+    c=child->cache=__cache_new(child);
+    c->parent=pc;
+    c->src=src;
+    c->map=malloc(sizeof(int)*(pc->rows?pc->rows:1));
+    for(i=0;i<pc->rows;i++)c->map[i]=-1;
+    for(i=0;i<len;i++)c->map[src[i]]=i;
+    for(j=0;j<c->cols;j++)
     {
-        if(strncmp(((label*)classlabel->self)->name,classfield,64)==0)goto found;
-        classlabel=classlabel->next;
+        if(__atomic_load_n(&pc->values[j],__ATOMIC_ACQUIRE))c->values[j]=__derive_column(c,j,COLUMN_VALUES);
+        if(__atomic_load_n(&pc->codes[j],__ATOMIC_ACQUIRE))c->codes[j]=__derive_column(c,j,COLUMN_CODES);
+        if(__atomic_load_n(&pc->perm[j],__ATOMIC_ACQUIRE))c->perm[j]=__derive_column(c,j,COLUMN_PERM);
     }
-    printf("KeyError: Field \"%s\" does not exist in dataset. Could not fit tree.\n",classfield);
-    return;
-    label* l=NULL;
-    double entropy,thresh,gain;
+    free(c->map);
+    c->parent=NULL;
+    c->src=c->map=NULL;
+}
+
+/*
+Links the cache of <child>, made of the lines of <parent> set on <mask> (the parent's lines <src>), to the cache of
+<parent>: the columns the parent has cached are carried over when the child first reads them, so a subset made by a
+split only copies the columns its own splits look at. <map> holds the index of each parent line on its subset, for all
+the subsets of the split. The parent and the three arrays must outlive the child.
+*/
+void __cache_link(dataset* parent,dataset* child,int* src,int* map,unsigned long long* mask)
+{
+    dataset_cache* pc=__atomic_load_n(&parent->cache,__ATOMIC_ACQUIRE),*c;
+    if(!pc)return;
+    c=child->cache=__cache_new(child);
+    c->parent=pc;
+    c->src=src;
+    c->map=map;
+    c->mask=mask;
+}
+
+void sort_by(dataset* dataset,char* field,char reverse)
+{
+    if(!dataset||!(dataset->col_labels))return;
+    int idx=select_label_index(dataset->col_labels,field),len,i,a,b,k,*perm,*src;
+    code_column* codes=NULL;
+    num_column* values=NULL;
+    tree_ll** ll,**sorted;
+    struct _dataset old;
+    if(idx<0)
+    {
+        printf("KeyError: Field \"%s\" does not exist in dataset. Could not sort.\n",field);
+        return;
+    }
+    len=ll_len(&dataset->lines);
+    if(len<2)return;
+    perm=cache_perm(dataset,idx);
+    if(select_label_by_index(dataset->col_labels,idx)->type==LABEL_NUM)values=cache_values(dataset,idx);
+    else codes=cache_codes(dataset,idx);
+    ll=ll_to_array(&dataset->lines);
+    sorted=malloc(sizeof(tree_ll*)*len);
+    src=malloc(sizeof(int)*len);
+    if(!reverse)memcpy(src,perm,sizeof(int)*len);
+    else
+    {
+        /*Runs of equal values are taken from the end, but keep their order*/
+        for(b=len,i=0;b>0;b=a)
+        {
+            for(a=b-1;a>0&&(values?VALUE_AT(values,perm[a-1])==VALUE_AT(values,perm[b-1]):CODE_AT(codes,perm[a-1])==CODE_AT(codes,perm[b-1]));a--);
+            for(k=a;k<b;k++)src[i++]=perm[k];
+        }
+    }
+    for(i=0;i<len;i++)sorted[i]=ll[src[i]];
+    /*The cached columns are reordered along with the lines (the sorted order of <field> becomes the lines' own order)*/
+    old=*dataset;
+    dataset->lines=array_to_ll(sorted,len);
+    dataset->cache=NULL;
+    __cache_derive(&old,dataset,src,len);
+    dataset_changed(&old);
+    free(src);
+    free(sorted);
+    free(ll);
+}
+
+double reduce(dataset* ds,char* field,void func(char field_type,void* field,double* acc,void* arg),void* arg,double init)
+{
+    if(!ds||!(ds->col_labels))return 0;
+    int idx=0,i;
+    double ret=init;
     tree_ll* lab=ds->col_labels;
-    dataset** subsets;
-    tree_ll* working;
-    f_numberfilter nuconf;
-    f_namefilter naconf;
+    tree_ll* line;
+    tree_ll* entry;
+    while(lab)
+    {
+        if(strncmp(((label*)lab->self)->name,field,64)==0)goto found;
+        lab=lab->next;
+        idx++;
+    }
+    printf("KeyError: Field \"%s\" does not exist in dataset. Could not apply reduction.\n",field);
+    return 0;
     found:
-    l=NULL;
-    lab=ds->col_labels;
-    entropy=class_entropy(ds,classfield);
-    while(!l&&entropy)
+    line=ds->lines;
+    while(line)
+    {
+        entry=(tree_ll*)line->self;
+        for(i=0;i<idx;i++)entry=entry->next;
+        func(((label*)lab->self)->type,entry->self,&ret,arg);
+        line=line->next;
+    }
+    return ret;
+}
+
+/*
+Reduction function for counting elements with a certain label
+field_type=LABEL_CAT
+arg=label* acc=0
+*/
+void r_count(char field_type,void* field,double* acc,void* arg)
+{
+    if(field_type!=LABEL_CAT)return;
+    *acc+=field==arg?1:0;
+}
+
+/*
+Reduction function for summing all elements
+field_type=LABEL_NUM
+arg=NULL acc=0
+*/
+void r_sum(char field_type,void* field,double* acc,void* arg)
+{
+    if(field_type!=LABEL_NUM)return;
+    *acc+=*(double*)field;
+}
+
+/*
+Reduction function for calculating the sum of all squared deviations from <double* arg>
+field_type=LABEL_NUM
+arg=&double acc=0
+*/
+void r_dev(char field_type,void* field,double* acc,void* arg)
+{
+    if(field_type!=LABEL_NUM)return;
+    *acc+=((*(double*)field)-*(double*)arg)*((*(double*)field)-*(double*)arg);
+}
+
+/*Lines per block of the statistics pass. Each block is summed on its own (a loop the compiler can vectorize) and merged*/
+#define STATS_BLOCK 256
+
+/*Count, mean, variance and range of <n> values*/
+void __numeric_stats(num_column* col,int n,column_stats* st)
+{
+    int i,j,bn;
+    double sum,bmean,m2,d,delta,min,max,total,mean=0,M2=0,block[STATS_BLOCK],*values;
+    st->min=n?VALUE_AT(col,0):0;
+    st->max=n?VALUE_AT(col,0):0;
+    for(i=0;i<n;i+=STATS_BLOCK)
+    {
+        bn=n-i<STATS_BLOCK?n-i:STATS_BLOCK;
+        /*Single precision blocks are widened first*/
+        values=(double*)col->values+i;
+        if(col->precision==PRECISION_FLOAT)for(values=block,j=0;j<bn;j++)block[j]=((float*)col->values)[i+j];
+        sum=0;
+        min=max=values[0];
+        for(j=0;j<bn;j++)
+        {
+            sum+=values[j];
+            min=values[j]<min?values[j]:min;
+            max=values[j]>max?values[j]:max;
+        }
+        bmean=sum/bn;
+        m2=0;
+        for(j=0;j<bn;j++)
+        {
+            d=values[j]-bmean;
+            m2+=d*d;
+        }
+        /*Welford's update, for a whole block at once (Chan et al.)*/
+        delta=bmean-mean;
+        total=i+bn;
+        mean+=delta*bn/total;
+        M2+=m2+delta*delta*((double)i*bn/total);
+        if(min<st->min)st->min=min;
+        if(max>st->max)st->max=max;
+    }
+    st->count=n;
+    st->mean=mean;
+    st->variance=n?M2/n:0;
+}
+
+column_stats* dataset_stats(dataset* ds)
+{
+    if(!ds||!ds->col_labels)return NULL;
+    dataset_cache* c=get_cache(ds);
+    column_stats* ret=__atomic_load_n(&c->stats,__ATOMIC_ACQUIRE);
+    int i,j,code,labels=0,*counts;
+    code_column* codes;
+    if(ret)return ret;
+    /*Every column is copied out of the lines in a single walk, then summarized on its own*/
+    cache_fill(ds);
+    for(j=0;j<c->cols;j++)if(c->columns[j]->type==LABEL_CAT)labels+=ll_len(&c->columns[j]->sublabels);
+    /*One block, so the cache can drop it with a single free*/
+    ret=calloc(1,sizeof(column_stats)*c->cols+sizeof(int)*(labels+1));
+    counts=(int*)(ret+c->cols);
+    for(j=0;j<c->cols;j++)
+    {
+        ret[j].column=c->columns[j];
+        ret[j].count=c->rows;
+        if(c->columns[j]->type==LABEL_NUM)__numeric_stats(cache_values(ds,j),c->rows,&ret[j]);
+        else
+        {
+            ret[j].label_counts=counts;
+            codes=cache_codes(ds,j);
+            for(i=0;i<c->rows;i++)if((code=CODE_AT(codes,i))<codes->labels)counts[code]++;
+            counts+=ll_len(&c->columns[j]->sublabels);
+        }
+    }
+    return __cache_publish(c,(void**)&c->stats,ret);
+}
+
+/*Returns the statistics of <field> (NULL if there's no such field)*/
+column_stats* __field_stats(dataset* ds,char* field,char* action)
+{
+    int idx;
+    if(!ds||!(ds->col_labels))return NULL;
+    if((idx=select_label_index(ds->col_labels,field))<0)
+    {
+        printf("KeyError: Field \"%s\" does not exist in dataset. Could not calculate %s.\n",field,action);
+        return NULL;
+    }
+    return &dataset_stats(ds)[idx];
+}
+
+double mean(dataset* ds,char* field)
+{
+    column_stats* st=__field_stats(ds,field,"mean");
+    return st?st->mean:0;
+}
+
+double variance(dataset* ds,char* field)
+{
+    column_stats* st=__field_stats(ds,field,"variance");
+    return st?st->variance:0;
+}
+
+double std_dev(dataset* ds,char* field)
+{
+    return sqrt(variance(ds,field));
+}
+
+/*Counts the lines of <ds> with each of the <classes> sublabels of its <col>th (categorical) field*/
+void class_counts(dataset* ds,int col,int classes,int* counts)
+{
+    int i,rows=get_cache(ds)->rows,words=MASK_WORDS(rows);
+    unsigned long long* bits=cache_label_rows(ds,col);
+    for(i=0;i<classes;i++)counts[i]=mask_count(bits+i*words,rows);
+}
+
+/*Entropy of <n> lines with the class counts <counts>*/
+double counts_entropy(int* counts,int classes,int n)
+{
+    int i;
+    double entropy=0,p;
+    if(!n)return 0;
+    for(i=0;i<classes;i++)
+    {
+        p=counts[i]/(double)n;
+        entropy+=p==0?0:p*log(p);
+    }
+    return -entropy;
+}
+
+/*Gini impurity of <n> lines with the class counts <counts>*/
+double counts_gini(int* counts,int classes,int n)
+{
+    int i;
+    double sum=0;
+    if(!n)return 0;
+    for(i=0;i<classes;i++)sum+=(double)counts[i]*counts[i];
+    return 1-sum/((double)n*n);
+}
+
+double class_entropy(dataset* ds,char* field)
+{
+    if(!ds||!(ds->col_labels))return 0;
+    int idx=select_label_index(ds->col_labels,field),classes,*counts;
+    label* lab;
+    double entropy;
+    if(idx<0)
+    {
+        printf("KeyError: Field \"%s\" does not exist in dataset. Could not calculate class entropy.\n",field);
+        return 0;
+    }
+    lab=select_label_by_index(ds->col_labels,idx);
+    if(lab->type!=LABEL_CAT||!ds->lines)return 0;
+    /*The lines of each class are kept as bitmaps, so counting them is a popcount*/
+    classes=ll_len(&lab->sublabels);
+    counts=malloc(sizeof(int)*(classes?classes:1));
+    class_counts(ds,idx,classes,counts);
+    entropy=counts_entropy(counts,classes,get_cache(ds)->rows);
+    free(counts);
+    return entropy;
+}
+double attribute_entropy(dataset* ds,char* field,char* classfield)
+{
+    if(!ds||!(ds->col_labels))return 0;
+    int len,idx=0;
+    double entropy=0;
+    tree_ll* lab=ds->col_labels,*clab;
+    dataset* sub;
+    f_namefilter conf;
+    while(lab)
+    {
+        if(strncmp(((label*)lab->self)->name,field,64)==0)goto found;
+        lab=lab->next;
+        idx++;
+    }
+    printf("KeyError: Field \"%s\" does not exist in dataset. Could not calculate attribute entropy.\n",field);
+    return 0;
+    found:
+    len=ll_len(&ds->lines);
+    if(((label*)lab->self)->type==LABEL_CAT)
+    {
+        clab=((label*)lab->self)->sublabels;
+        while(clab)
+        {
+            conf.field_index=idx;
+            conf.target=clab->self;
+            sub=filter_dataset(ds,f_by_name,&conf);
+
+            entropy+=(ll_len(&sub->lines)/(double)len)*class_entropy(sub,classfield);
+
+            free_dataset(&sub);
+            clab=clab->next;
+        }
+    }
+    return entropy;
+}
+double attribute_num_entropy(dataset* ds,char* field,char* classfield,double threshold)
+{
+    if(!ds||!(ds->col_labels))return 0;
+    int len,idx=0;
+    double entropy=0;
+    tree_ll* lab=ds->col_labels;
+    dataset* sub;
+    f_numberfilter conf;
+    while(lab)
+    {
+        if(strncmp(((label*)lab->self)->name,field,64)==0)goto found;
+        lab=lab->next;
+        idx++;
+    }
+    printf("KeyError: Field \"%s\" does not exist in dataset. Could not calculate attribute entropy.\n",field);
+    return 0;
+    found:
+    len=ll_len(&ds->lines);
+    if(((label*)lab->self)->type==LABEL_NUM)
+    {
+        conf.field_index=idx;
+        conf.target=threshold;
+        conf.bt=0;
+        sub=filter_dataset(ds,f_by_number,&conf);
+        entropy+=(ll_len(&sub->lines)/(double)len)*class_entropy(sub,classfield);
+        free_dataset(&sub);
+        conf.bt=1;
+        sub=filter_dataset(ds,f_by_number,&conf);
+        entropy+=(ll_len(&sub->lines)/(double)len)*class_entropy(sub,classfield);
+        free_dataset(&sub);
+    }
+    return entropy;
+}
+
+/*
+How splits are scored: by the impurity of each side, weighted by its lines.
+The entropy of <n> lines with class counts c is (n*log(n)-sum(c*log(c)))/n, so with a table of c*log(c) for every count
+up to the lines of the dataset, it takes no logarithms, like the Gini impurity.
+*/
+typedef struct _split_score{
+    char criterion;/*CRITERION_ENTROPY or CRITERION_GINI*/
+    double* nlogn;/*c*log(c) for c up to the lines of the dataset (CRITERION_ENTROPY only)*/
+}split_score;
+
+/*Sets up <sc> for datasets of up to <n> lines*/
+void __score_init(split_score* sc,char criterion,int n)
+{
+    int c;
+    sc->criterion=criterion;
+    sc->nlogn=NULL;
+    if(criterion==CRITERION_GINI)return;
+    sc->nlogn=malloc(sizeof(double)*(n+1));
+    sc->nlogn[0]=0;
+    for(c=1;c<=n;c++)sc->nlogn[c]=c*log(c);
+}
+
+void __score_free(split_score* sc)
+{
+    free(sc->nlogn);
+    sc->nlogn=NULL;
+}
+
+/*Impurity of <n> lines with the class counts <counts>*/
+double __impurity(split_score* sc,int* counts,int classes,int n)
+{
+    int i;
+    double sum=0;
+    if(!n)return 0;
+    if(sc->criterion==CRITERION_GINI)return counts_gini(counts,classes,n);
+    for(i=0;i<classes;i++)sum+=sc->nlogn[counts[i]];
+    return (sc->nlogn[n]-sum)/n;
+}
+
+/*Impurity of a split with class counts <left> on one side and <total>-<left> on the other*/
+double __split_impurity(split_score* sc,int* left,int* total,int classes,int nleft,int n)
+{
+    int i,nright=n-nleft;
+    double l=0,r=0;
+    if(sc->criterion==CRITERION_GINI)
+    {
+        /*The sums of the squared counts of each side*/
+        for(i=0;i<classes;i++)
+        {
+            l+=(double)left[i]*left[i];
+            r+=(double)(total[i]-left[i])*(total[i]-left[i]);
+        }
+        return 1-((nleft?l/nleft:0)+(nright?r/nright:0))/n;
+    }
+    for(i=0;i<classes;i++)l+=sc->nlogn[left[i]]+sc->nlogn[total[i]-left[i]];
+    return (sc->nlogn[nleft]+sc->nlogn[nright]-l)/n;
+}
+
+/*
+Moves the <cut> of a sorted column up to the end of the run of values equal to the <pos>th one, keeping the class
+counts of the lines before it on <left>. Returns the value at <pos>.
+*/
+double __move_cut(num_column* values,int* perm,code_column* codes,int n,int pos,int* cut,int* left)
+{
+    double threshold=VALUE_AT(values,perm[pos]);
+    int end,code;
+    for(end=pos+1;end<n&&VALUE_AT(values,perm[end])==threshold;end++);
+    for(;*cut<end;(*cut)++)if((code=CODE_AT(codes,perm[*cut]))<codes->labels)left[code]++;
+    for(;*cut>end;(*cut)--)if((code=CODE_AT(codes,perm[*cut-1]))<codes->labels)left[code]--;
+    return threshold;
+}
+
+/*
+Optimizes the threshold of the <idx>th (numerical) field of <ds>, for the <classindex>th field (with <classes> classes).
+The lines are visited in the cached sorted order and the class counts below the threshold are updated as it moves, so
+each step costs O(classes) and the dataset is never reordered.
+Stores the impurity of the best split (scored by <sc>) on <impurity> and the size of each side on <sizes>.
+*/
+double _optimize_threshold(dataset* ds,int idx,int classindex,int classes,split_score* sc,double* impurity,int* sizes)
+{
+    dataset_cache* c=get_cache(ds);
+    int n=c->rows,pos,cut=0,bestcut,dir=1,i,code;
+    int* perm,*left,*total;
+    code_column* codes;
+    num_column* values;
+    double threshold,pt,ent,pent;
+    *impurity=0;
+    sizes[0]=sizes[1]=0;
+    if(!n)return 0;
+    perm=cache_perm(ds,idx);
+    codes=cache_codes(ds,classindex);
+    values=cache_values(ds,idx);
+    left=calloc(classes+1,sizeof(int));
+    total=calloc(classes+1,sizeof(int));
+    for(i=0;i<n;i++)if((code=CODE_AT(codes,i))<codes->labels)total[code]++;
+    pos=n/2;
+    pt=__move_cut(values,perm,codes,n,pos,&cut,left);
+    bestcut=cut;
+    pent=__split_impurity(sc,left,total,classes,cut,n);
+    while(dir>=-1&&pos+dir>0&&pos+dir<n)
+    {
+        pos+=dir;
+        threshold=__move_cut(values,perm,codes,n,pos,&cut,left);
+        ent=__split_impurity(sc,left,total,classes,cut,n);
+        if(ent>pent)
+        {
+            dir-=2;
+            pos+=dir;
+        }
+        else
+        {
+            pent=ent;
+            pt=threshold;
+            bestcut=cut;
+        }
+    }
+    *impurity=pent;
+    sizes[0]=bestcut;
+    sizes[1]=n-bestcut;
+    free(left);
+    free(total);
+    return pt;
+}
+
+double optimize_threshold(dataset* ds,char* field,char* classfield)
+{
+    if(!ds||!field||!classfield||!(ds->col_labels)||!ds->lines)return 0;
+    int idx=select_label_index(ds->col_labels,field),classindex=select_label_index(ds->col_labels,classfield),sizes[2];
+    label* classlabel;
+    split_score sc;
+    double impurity,ret;
+    if(idx<0||classindex<0)
+    {
+        printf("KeyError: Field \"%s\" does not exist in dataset. Could not optimize threshold.\n",idx<0?field:classfield);
+        return 0;
+    }
+    classlabel=select_label_by_index(ds->col_labels,classindex);
+    if(select_label_by_index(ds->col_labels,idx)->type!=LABEL_NUM||classlabel->type!=LABEL_CAT)return 0;
+    __score_init(&sc,CRITERION_ENTROPY,get_cache(ds)->rows);
+    ret=num_threshold(cache_values(ds,idx),
+        _optimize_threshold(ds,idx,classindex,ll_len(&classlabel->sublabels),&sc,&impurity,sizes));
+    __score_free(&sc);
+    return ret;
+}
+
+/*
+Returns a new dataset with the lines of <ds> whose bits are set on <mask> (or unset, if not <keep>), carrying its cache
+over.
+With a <scratch> arena (subsets made by a split), the list of lines is allocated from it, the cache is linked to the one
+of <ds> rather than copied (see __cache_link, which <map> and <mask> are for), and the subset must be freed with
+__free_subset before the arena is.
+*/
+dataset* __mask_subset(dataset* ds,dataset_cache* c,unsigned long long* mask,char keep,arena* scratch,int* map)
+{
+    dataset* ret=Dataset(ds->col_labels);
+    tree_ll* tail=NULL,*nodes=NULL;
+    int i,w,len=0,words=MASK_WORDS(c->rows),*src;
+    unsigned long long word;
+    if(scratch)
+    {
+        /*The whole list is a single block*/
+        i=keep?mask_count(mask,c->rows):c->rows-mask_count(mask,c->rows);
+        src=arena_alloc(scratch,sizeof(int)*(i?i:1));
+        nodes=arena_alloc(scratch,sizeof(tree_ll)*i);
+    }
+    else src=malloc(sizeof(int)*(c->rows?c->rows:1));
+    for(w=0;w<words;w++)
+    {
+        word=keep?mask[w]:~mask[w];
+        if(w==words-1&&c->rows%64)word&=(1ULL<<(c->rows%64))-1;
+        while(word)
+        {
+            i=w*64+__builtin_ctzll(word);
+            word&=word-1;
+            if(nodes)
+            {
+                nodes[len].self=c->lines[i];
+                nodes[len].prev=len?&nodes[len-1]:NULL;
+                nodes[len].next=NULL;
+                if(len)nodes[len-1].next=&nodes[len];
+            }
+            else tail=ll_push(tail?&tail:&ret->lines,c->lines[i]);
+            if(map)map[i]=len;
+            src[len++]=i;
+        }
+    }
+    if(nodes&&len)ret->lines=nodes;
+    if(scratch&&keep)__cache_link(ds,ret,src,map,mask);
+    else __cache_derive(ds,ret,src,len);
+    if(!scratch)free(src);
+    return ret;
+}
+
+/*Frees a subset whose list of lines is on an arena*/
+void __free_subset(dataset** ds)
+{
+    if(!ds||!*ds)return;
+    (*ds)->lines=NULL;
+    free_dataset(ds);
+}
+
+/*
+filter_dataset for f_by_number and f_by_name: the filtered column is compared as a whole by the vectorized kernels.
+Returns NULL if the filter doesn't fit its column, so the generic path can handle it.
+*/
+dataset* __filter_column(dataset* ds,char func(tree_ll* line,void* arg),void* arg)
+{
+    dataset_cache* c=get_cache(ds);
+    unsigned long long* mask;
+    dataset* ret;
+    int idx,code=-1;
+    char keep=1;
+    idx=func==f_by_number?((f_numberfilter*)arg)->field_index:((f_namefilter*)arg)->field_index;
+    if(idx<0||idx>=c->cols)return NULL;
+    /*Single precision columns can't tell apart lines whose values round to the same float*/
+    if(func==f_by_number&&(c->columns[idx]->type!=LABEL_NUM||cache_values(ds,idx)->precision==PRECISION_FLOAT))return NULL;
+    if(func==f_by_name&&(c->columns[idx]->type!=LABEL_CAT||
+        (code=sublabel_index(c->columns[idx]->sublabels,((f_namefilter*)arg)->target))<0))return NULL;
+    mask=malloc(sizeof(unsigned long long)*(c->rows?MASK_WORDS(c->rows):1));
+    if(func==f_by_number)
+    {
+        mask_num(cache_values(ds,idx),c->rows,((f_numberfilter*)arg)->target,mask);
+        keep=!((f_numberfilter*)arg)->bt;
+    }
+    else mask_code(cache_codes(ds,idx),c->rows,code,mask);
+    ret=__mask_subset(ds,c,mask,keep,NULL,NULL);
+    free(mask);
+    return ret;
+}
+
+dataset* filter_dataset(dataset* ds,char func(tree_ll* line,void* arg),void* arg)
+{
+    if(!ds||!ds->col_labels||!ds->lines)return NULL;
+    dataset* ret;
+    if((func==f_by_number||func==f_by_name)&&(ret=__filter_column(ds,func,arg)))return ret;
+    ret=Dataset(ds->col_labels);
+    dataset_cache* c=__atomic_load_n(&ds->cache,__ATOMIC_ACQUIRE);
+    tree_ll* cur=ds->lines,*tail=NULL;
+    int i=0,len=0,*src=NULL;
+    /*The kept lines are remembered, so the cached columns can be carried over*/
+    if(c)src=malloc(sizeof(int)*(c->rows?c->rows:1));
+    while(cur)
+    {
+        if(func(cur->self,arg))
+        {
+            tail=ll_push(tail?&tail:&ret->lines,cur->self);
+            if(src)src[len]=i;
+            len++;
+        }
+        cur=cur->next;
+        i++;
+    }
+    if(src)
+    {
+        __cache_derive(ds,ret,src,len);
+        free(src);
+    }
+    return ret;
+}
+
+char f_by_name(tree_ll* line,void* arg)
+{
+    int i;
+    for(i=0;i<((f_namefilter*)arg)->field_index;i++)line=line->next;
+    return line->self==((f_namefilter*)arg)->target;
+}
+
+char f_by_number(tree_ll* line,void* arg)
+{
+    int i;
+    char r;
+    for(i=0;i<((f_numberfilter*)arg)->field_index;i++)line=line->next;
+    r=(*((double*)line->self)<=((f_numberfilter*)arg)->target);
+    if(((f_numberfilter*)arg)->bt)r=!r;
+    return r;
+}
+
+row_set* RowSet(int rows)
+{
+    row_set* ret=malloc(sizeof(row_set));
+    ret->rows=rows;
+    ret->bits=calloc(MASK_WORDS(rows)+1,sizeof(unsigned long long));
+    return ret;
+}
+
+void free_row_set(row_set** set)
+{
+    if(!set||!(*set))return;
+    free((*set)->bits);
+    free(*set);
+    *set=NULL;
+}
+
+int row_set_count(row_set* set)
+{
+    if(!set)return 0;
+    return mask_count(set->bits,set->rows);
+}
+
+int row_set_and_count(row_set* a,row_set* b)
+{
+    if(!a||!b)return 0;
+    return mask_and_count(a->bits,b->bits,a->rows<b->rows?a->rows:b->rows);
+}
+
+void row_set_and(row_set* a,row_set* b,row_set* out)
+{
+    if(!a||!b||!out)return;
+    mask_and(a->bits,b->bits,out->bits,out->rows);
+}
+
+void row_set_andnot(row_set* a,row_set* b,row_set* out)
+{
+    if(!a||!b||!out)return;
+    mask_andnot(a->bits,b->bits,out->bits,out->rows);
+}
+
+row_set* label_rows(dataset* ds,char* field,label* lab)
+{
+    if(!ds||!ds->col_labels)return NULL;
+    int idx=select_label_index(ds->col_labels,field),k,rows;
+    row_set* ret;
+    if(idx<0||select_label_by_index(ds->col_labels,idx)->type!=LABEL_CAT)
+    {
+        printf("KeyError: Categorical field \"%s\" does not exist in dataset. Could not select lines.\n",field);
+        return NULL;
+    }
+    rows=get_cache(ds)->rows;
+    ret=RowSet(rows);
+    k=sublabel_index(select_label_by_index(ds->col_labels,idx)->sublabels,lab);
+    if(k>=0)memcpy(ret->bits,cache_label_rows(ds,idx)+k*MASK_WORDS(rows),sizeof(unsigned long long)*MASK_WORDS(rows));
+    return ret;
+}
+
+row_set* threshold_rows(dataset* ds,char* field,double threshold)
+{
+    if(!ds||!ds->col_labels)return NULL;
+    int idx=select_label_index(ds->col_labels,field);
+    row_set* ret;
+    if(idx<0||select_label_by_index(ds->col_labels,idx)->type!=LABEL_NUM)
+    {
+        printf("KeyError: Numerical field \"%s\" does not exist in dataset. Could not select lines.\n",field);
+        return NULL;
+    }
+    ret=RowSet(get_cache(ds)->rows);
+    mask_num(cache_values(ds,idx),ret->rows,threshold,ret->bits);
+    return ret;
+}
+
+dataset* row_set_dataset(dataset* ds,row_set* set)
+{
+    if(!ds||!set)return NULL;
+    dataset_cache* c=get_cache(ds);
+    if(set->rows!=c->rows)return NULL;
+    return __mask_subset(ds,c,set->bits,1,NULL,NULL);
+}
+
+/*chi_squared on class counts: <root> holds the counts of the parent, <children> <len> rows of counts*/
+double chi_squared_counts(int* root,int* children,int len,int classes)
+{
+    int i,j;
+    double ret=0,expected;
+    if(classes<1)return 0;
+    expected=root[0]*(1/(double)len);
+    for(i=0;i<len;i++)
+    {
+        for(j=0;j<classes;j++)
+            ret+=((children[i*classes+j]-expected)*(children[i*classes+j]-expected))/expected;
+    }
+    return ret;
+}
+
+double chi_squared(dataset* root,dataset** children,int len,label* classlabel)
+{
+    if(!root||!children||classlabel->type!=LABEL_CAT)return 0;
+    int i,col=sublabel_index(root->col_labels,classlabel),classes=ll_len(&classlabel->sublabels),*counts;
+    double ret;
+    if(col<0)return 0;
+    for(i=0;i<len;i++)if(!children[i])return 0;
+    counts=malloc(sizeof(int)*(len+1)*(classes?classes:1));
+    class_counts(root,col,classes,counts);
+    for(i=0;i<len;i++)class_counts(children[i],col,classes,counts+(i+1)*classes);
+    ret=chi_squared_counts(counts,counts+classes,len,classes);
+    free(counts);
+    return ret;
+}
+
+dataset* sample_dataset(dataset* ds,int len,char* classfield)
+{
+    return sample_dataset_r(ds,len,classfield,NULL,NULL);
+}
+
+dataset* sample_dataset_oob(dataset* ds,int len,char* classfield,dataset** oob)
+{
+    return sample_dataset_r(ds,len,classfield,oob,NULL);
+}
+
+dataset* sample_dataset_r(dataset* ds,int len,char* classfield,dataset** oob,tree_rng* rng)
+{
+    if(oob)*oob=NULL;
+    if(!ds||len==0)return NULL;
+    label* classlabel=select_label(ds->col_labels,classfield);
+    if(!classlabel)return NULL;
+    char* selected;
+    int cur,subs=ll_len(&classlabel->sublabels),olen=ll_len(&ds->lines),tlen,clen,slen,sel,i;
+    f_namefilter conf;
+    conf.field_index=select_label_index(ds->col_labels,classfield);
+    tree_ll* cval,*line,*oob_tail=NULL;
+    dataset* ret=Dataset(ds->col_labels);
+    dataset* subset;
+    if(oob)*oob=Dataset(ds->col_labels);
+
+    cval=classlabel->sublabels;
+    for(cur=0;cur<subs;cur++)
+    {
+        conf.target=cval->self;
+        subset=filter_dataset(ds,f_by_name,&conf);
+        slen=ll_len(&subset->lines);
+        clen=0;
+        selected=calloc(slen,1);
+        tlen=len*((double)slen/(double)olen);
+        while(clen<tlen)
+        {
+            while(selected[(sel=rng_below(rng,slen))]);
+            line=subset->lines;
+            for(i=0;i<sel;i++)line=line->next;
+            ll_push(&ret->lines,line->self);
+            selected[sel]=1;
+            clen++;
+        }
+        if(oob)
+        {
+            /*Whatever wasn't selected is out-of-bag*/
+            line=subset->lines;
+            for(i=0;i<slen;i++)
+            {
+                if(!selected[i])oob_tail=ll_push(oob_tail?&oob_tail:&(*oob)->lines,line->self);
+                line=line->next;
+            }
+        }
+        free(selected);
+        free_dataset(&subset);
+        cval=cval->next;
+    }
+    return ret;
+}
+
+label* most_frequent_class(tree_node* root,dataset* ds,char* classfield)
+{
+    if(!root||!ds)return NULL;
+    label* classlabel=select_label(ds->col_labels,classfield),*result;
+    unsigned int len=ll_len(&classlabel->sublabels),occurences[len],i,imax=0,max=0;
+    for(i=0;i<len;i++)occurences[i]=0;
+    tree_ll* line=ds->lines;
+    foreach(line,{
+        result=classify(root,line->self,ds->col_labels);
+        if(result)
+        {
+            occurences[select_label_index(classlabel->sublabels,result->name)]++;
+        }
+    });
+    for(i=0;i<len;i++)
+    {
+        if(occurences[i]>max)
+        {
+            imax=i;
+            max=occurences[i];
+        }
+    }
+    return select_label_by_index(classlabel->sublabels,imax);
+}
+
+/*
+Trees
+*/
+
+void tree_options_init(tree_options* opts)
+{
+    if(!opts)return;
+    opts->chi_square_significance_limit=0;
+    opts->max_depth=0;
+    opts->min_samples_split=2;
+    opts->min_samples_leaf=1;
+    opts->max_leaves=0;
+    opts->min_gain=0;
+    opts->mtry=0;
+    opts->threads=0;
+    opts->parallel_cutoff=256;
+    opts->parallel_features=8;
+    opts->seed=0;
+    opts->criterion=CRITERION_ENTROPY;
+    opts->binary_categorical=0;
+}
+
+/*Tree fitting modes*/
+#define FIT_BEST 0 /*Optimized splits on all the attributes*/
+#define FIT_RANDOM 1 /*Optimized splits on a random subset of the attributes*/
+#define FIT_EXTRA 2 /*Random splits on a random subset of the attributes (extremely randomized trees)*/
+
+/*State shared by all the nodes of a tree while it's being fitted*/
+typedef struct _fit_state{
+    label* classlabel;
+    int classindex;
+    int classes;/*Number of classes*/
+    label** columns;/*Column labels, by index*/
+    int cols;
+    char mode;/*FIT_BEST, FIT_RANDOM or FIT_EXTRA*/
+    thread_pool* pool;/*Pool for fitting subtrees in parallel (NULL for serial fitting)*/
+    int leaves;/*Number of leaves the tree will have if no more splits are made*/
+    int subset_words;/*Words of the biggest bitset of a binary categorical split (0 without binary_categorical)*/
+    split_score score;
+}fit_state;
+
+/*Finds the smallest and biggest values of the <idx>th field on <ds>*/
+void value_range(dataset* ds,int idx,double* min,double* max)
+{
+    int i,n=get_cache(ds)->rows;
+    num_column* values=cache_values(ds,idx);
+    *min=__DBL_MAX__;
+    *max=-__DBL_MAX__;
+    for(i=0;i<n;i++)
+    {
+        if(VALUE_AT(values,i)<*min)*min=VALUE_AT(values,i);
+        if(VALUE_AT(values,i)>*max)*max=VALUE_AT(values,i);
+    }
+}
+
+/*
+Calculates, in a single pass, the impurity of <ds> when partitioned by <attribute> (the <idx>th field), at <threshold>
+for numerical attributes. The size of each child (2 for numerical attributes, one per sublabel for categorical ones)
+is stored on <sizes>.
+*/
+double partition_impurity(dataset* ds,fit_state* st,label* attribute,int idx,double threshold,int* sizes)
+{
+    int i,j,child,n=0,rows=get_cache(ds)->rows,len=attribute->type==LABEL_NUM?2:ll_len(&attribute->sublabels);
+    int* counts=calloc(len*st->classes+1,sizeof(int)),class;
+    code_column* classes=cache_codes(ds,st->classindex),*codes=NULL;
+    double impurity=0;
+    num_column* values=NULL;
+    if(attribute->type==LABEL_NUM)values=cache_values(ds,idx);
+    else codes=cache_codes(ds,idx);
+    for(i=0;i<rows;i++)
+    {
+        child=values?(VALUE_AT(values,i)<=threshold?0:1):CODE_AT(codes,i);
+        class=CODE_AT(classes,i);
+        if(child<len&&class<st->classes)counts[child*st->classes+class]++;
+    }
+    for(i=0;i<len;i++)
+    {
+        sizes[i]=0;
+        for(j=0;j<st->classes;j++)sizes[i]+=counts[i*st->classes+j];
+        n+=sizes[i];
+    }
+    for(i=0;i<len;i++)if(sizes[i])impurity+=(sizes[i]/(double)n)*__impurity(&st->score,counts+i*st->classes,st->classes,sizes[i]);
+    free(counts);
+    return impurity;
+}
+
+/*
+Splits the sublabels of the <idx>th (categorical) field of <ds> in two, for binary_categorical trees.
+The sublabels are sorted by the proportion of the node's most frequent class among their lines, then cut like a sorted
+numerical column: one sweep moves them to the first side one at a time, updating its class counts. With two classes,
+the best cut of that order is the best of all the ways of splitting them in two.
+Without <optimize>, the cut is placed at <draw> (in [0,1)) instead.
+Stores the sublabels of the first side on <subset> and the size of each side on <sizes>.
+Returns the impurity of the split, or -1 if less than two sublabels have lines.
+*/
+double _optimize_subset(dataset* ds,fit_state* st,int idx,char optimize,double draw,unsigned long long* subset,int* sizes)
+{
+    code_column* codes=cache_codes(ds,idx),*classes=cache_codes(ds,st->classindex);
+    int i,j,code,class,len=codes->labels,rows=get_cache(ds)->rows,n=0,present=0,majority=0,cut,best=1,nleft=0;
+    int* counts=calloc((size_t)len*st->classes+1,sizeof(int)),*size=calloc(len+1,sizeof(int)),*order=malloc(sizeof(int)*(len+1));
+    int* total=calloc(st->classes+1,sizeof(int)),*left=calloc(st->classes+1,sizeof(int));
+    double* keys=malloc(sizeof(double)*(len+1)),impurity,best_impurity=-1;
+    memset(subset,0,sizeof(unsigned long long)*MASK_WORDS(len));
+    sizes[0]=sizes[1]=0;
+    for(i=0;i<rows;i++)
+    {
+        code=CODE_AT(codes,i);
+        class=CODE_AT(classes,i);
+        if(code<len&&class<st->classes)
+        {
+            counts[code*st->classes+class]++;
+            size[code]++;
+            total[class]++;
+            n++;
+        }
+    }
+    for(j=1;j<st->classes;j++)if(total[j]>total[majority])majority=j;
+    for(i=0;i<len;i++)
+    {
+        if(!size[i])continue;
+        keys[i]=counts[i*st->classes+majority]/(double)size[i];
+        order[present++]=i;
+    }
+    if(present<2)goto end;
+    sort_indexes(order,present,keys);
+    if(!optimize)best=1+(int)(draw*(present-1));
+    for(cut=1;cut<present&&(optimize||cut<=best);cut++)
+    {
+        for(j=0;j<st->classes;j++)left[j]+=counts[order[cut-1]*st->classes+j];
+        nleft+=size[order[cut-1]];
+        if(!optimize&&cut<best)continue;
+        impurity=__split_impurity(&st->score,left,total,st->classes,nleft,n);
+        if(best_impurity<0||impurity<best_impurity)
+        {
+            best_impurity=impurity;
+            best=cut;
+            sizes[0]=nleft;
+        }
+    }
+    sizes[1]=n-sizes[0];
+    for(i=0;i<best;i++)subset[order[i]/64]|=1ULL<<(order[i]%64);
+    if(sizes[0]>=sizes[1])for(i=0;i<len;i++)if(!size[i])subset[i/64]|=1ULL<<(i%64);
+    end:
+    free(counts);
+    free(size);
+    free(order);
+    free(total);
+    free(left);
+    free(keys);
+    return best_impurity;
+}
+
+/*
+Evaluates splitting <ds> on <attribute> (the <idx>th field).
+Returns the gain, how much the split decreases the impurity (or -1 if it would leave a child too small), and the threshold
+for numerical attributes.
+<draw> is a random number in [0,1) for placing random thresholds.
+Categorical attributes are split in two if there's a <subset> to store the sublabels of the first side on.
+*/
+double evaluate_split(dataset* ds,char* classfield,double impurity,tree_options* opts,fit_state* st,label* attribute,int idx,
+    double draw,double* threshold,unsigned long long* subset)
+{
+    int i,len=attribute->type==LABEL_NUM||subset?2:ll_len(&attribute->sublabels);
+    int sizes[len>0?len:1];
+    double gain,min,max,child_impurity;
+    *threshold=0;
+    if(subset)
+    {
+        if((child_impurity=_optimize_subset(ds,st,idx,st->mode!=FIT_EXTRA,draw,subset,sizes))<0)return -1;
+        /*The partition of a binary split is the number of sublabels its bitset covers*/
+        *threshold=ll_len(&attribute->sublabels);
+        for(i=0;i<2;i++)if(sizes[i]<opts->min_samples_leaf)return -1;
+        return impurity-child_impurity;
+    }
+    if(st->mode==FIT_EXTRA)
+    {
+        /*A single random cut between the node's extremes, scored in one pass (no sorting)*/
+        if(attribute->type==LABEL_NUM)
+        {
+            value_range(ds,idx,&min,&max);
+            if(min>=max)return -1;
+            *threshold=num_threshold(cache_values(ds,idx),min+(max-min)*draw);
+        }
+        gain=impurity-partition_impurity(ds,st,attribute,idx,*threshold,sizes);
+        for(i=0;i<len;i++)if(sizes[i]<opts->min_samples_leaf)return -1;
+        return gain;
+    }
+    if(attribute->type==LABEL_NUM)
+    {
+        *threshold=num_threshold(cache_values(ds,idx),
+            _optimize_threshold(ds,idx,st->classindex,st->classes,&st->score,&child_impurity,sizes));
+        gain=impurity-child_impurity;
+    }
+    else gain=impurity-partition_impurity(ds,st,attribute,idx,0,sizes);
+    if(gain>opts->min_gain)for(i=0;i<len;i++)if(sizes[i]<opts->min_samples_leaf)return -1;
+    return gain;
+}
+
+int __intcmp(const void* a,const void* b)
+{
+    return *(int*)a-*(int*)b;
+}
+
+/*A range of split candidates to be evaluated on the thread pool*/
+typedef struct _split_task{
+    dataset* ds;
+    char* classfield;
+    double impurity;
+    tree_options* opts;
+    fit_state* st;
+    int* candidates;
+    double* draws;
+    double* gains;
+    double* thresholds;
+    unsigned long long* subsets;
+    int start,end;
+}split_task;
+
+/*Where the sublabels of the binary split of the <i>th candidate go (NULL unless it's categorical and <subsets> is set)*/
+unsigned long long* __candidate_subset(fit_state* st,unsigned long long* subsets,int* candidates,int i)
+{
+    return subsets&&st->columns[candidates[i]]->type==LABEL_CAT?subsets+(size_t)i*st->subset_words:NULL;
+}
+
+void __split_task(void* arg)
+{
+    split_task* task=arg;
+    int i;
+    for(i=task->start;i<task->end;i++)
+    {
+        task->gains[i]=evaluate_split(task->ds,task->classfield,task->impurity,task->opts,task->st,
+            task->st->columns[task->candidates[i]],task->candidates[i],task->draws[i],&task->thresholds[i],
+            __candidate_subset(task->st,task->subsets,task->candidates,i));
+    }
+}
+
+/*
+Chooses the attribute for splitting a node (with <n> lines) out of <mtry> candidates (see tree_options).
+For binary categorical splits, the sublabels of the first side are returned on <subset> (NULL for other splits).
+Returns 0 if there's no split with enough gain.
+*/
+char choose_split(dataset* ds,int n,char* classfield,double impurity,tree_options* opts,fit_state* st,tree_rng* rng,
+    label** attribute,int* index,double* threshold,unsigned long long** subset)
+{
+    int i,j,tmp,features=st->cols-1,mtry=opts->mtry,chunks,best=-1;
+    int candidates[features>0?features:1];
+    double maxgain=opts->min_gain,*draws,*gains,*thresholds;
+    unsigned long long* subsets,*s;
+    split_task* tasks;
+    task_group group;
+    *attribute=NULL;
+    *subset=NULL;
+    if(features<1)return 0;
+    if(mtry<=0)mtry=st->mode==FIT_BEST?features:(int)sqrt(features);
+    if(mtry<1)mtry=1;
+    if(mtry>features)mtry=features;
+    /*Every attribute but the class*/
+    for(i=0,j=0;i<st->cols;i++)if(i!=st->classindex)candidates[j++]=i;
+    if(mtry<features)
+    {
+        /*We draw <mtry> of them and keep them in column order*/
+        for(i=0;i<mtry;i++)
+        {
+            j=i+rng_below(rng,features-i);
+            tmp=candidates[i];
+            candidates[i]=candidates[j];
+            candidates[j]=tmp;
+        }
+        qsort(candidates,mtry,sizeof(int),__intcmp);
+    }
+    draws=malloc(sizeof(double)*mtry);
+    gains=malloc(sizeof(double)*mtry);
+    thresholds=malloc(sizeof(double)*mtry);
+    subsets=st->subset_words?malloc(sizeof(unsigned long long)*mtry*st->subset_words):NULL;
+    /*Random thresholds are drawn beforehand, so the result doesn't depend on the order of evaluation*/
+    for(i=0;i<mtry;i++)draws[i]=st->mode==FIT_EXTRA?rng_uniform(rng):0;
+    if(st->pool&&opts->parallel_features>0&&mtry>=opts->parallel_features&&n>=opts->parallel_cutoff)
+    {
+        /*Wide nodes evaluate their candidates in parallel, a few contiguous ranges per thread.
+        The class column is cached beforehand, since every task needs it*/
+        cache_codes(ds,st->classindex);
+        chunks=thread_pool_threads(st->pool)*4;
+        if(chunks>mtry)chunks=mtry;
+        tasks=malloc(sizeof(split_task)*chunks);
+        task_group_init(&group);
+        for(i=0;i<chunks;i++)
+        {
+            tasks[i].ds=ds;
+            tasks[i].classfield=classfield;
+            tasks[i].impurity=impurity;
+            tasks[i].opts=opts;
+            tasks[i].st=st;
+            tasks[i].candidates=candidates;
+            tasks[i].draws=draws;
+            tasks[i].gains=gains;
+            tasks[i].thresholds=thresholds;
+            tasks[i].subsets=subsets;
+            tasks[i].start=(int)((long)mtry*i/chunks);
+            tasks[i].end=(int)((long)mtry*(i+1)/chunks);
+            thread_pool_spawn(st->pool,&group,__split_task,&tasks[i]);
+        }
+        thread_pool_wait(st->pool,&group);
+        free(tasks);
+    }
+    else
+    {
+        for(i=0;i<mtry;i++)
+            gains[i]=evaluate_split(ds,classfield,impurity,opts,st,st->columns[candidates[i]],candidates[i],draws[i],&thresholds[i],
+                __candidate_subset(st,subsets,candidates,i));
+    }
+    /*The best gain wins, ties go to the first column*/
+    for(i=0;i<mtry;i++)
+    {
+        if(gains[i]>maxgain)
+        {
+            *attribute=st->columns[candidates[i]];
+            *index=candidates[i];
+            *threshold=thresholds[i];
+            maxgain=gains[i];
+            best=i;
+        }
+    }
+    if(best>=0&&(s=__candidate_subset(st,subsets,candidates,best)))
+    {
+        j=MASK_WORDS(ll_len(&(*attribute)->sublabels));
+        *subset=malloc(sizeof(unsigned long long)*(j+1));
+        memcpy(*subset,s,sizeof(unsigned long long)*j);
+    }
+    free(draws);
+    free(gains);
+    free(thresholds);
+    free(subsets);
+    return *attribute!=NULL;
+}
+
+/*Reserves room for <n> more leaves on the tree. Returns 0 if they would exceed <max_leaves>*/
+char reserve_leaves(fit_state* st,int max_leaves,int n)
+{
+    int cur=__atomic_load_n(&st->leaves,__ATOMIC_ACQUIRE);
+    do
+    {
+        if(max_leaves>0&&cur+n>max_leaves)return 0;
+    }
+    while(!__atomic_compare_exchange_n(&st->leaves,&cur,cur+n,0,__ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE));
+    return 1;
+}
+
+/*A subtree to be fitted on the thread pool*/
+typedef struct _fit_task{
+    tree_node** root;
+    dataset* ds;
+    char* classfield;
+    tree_options* opts;
+    fit_state* st;
+    tree_rng rng;
+    int depth;
+    int* counts;/*Class counts of the lines*/
+}fit_task;
+
+void _fit_tree(tree_node** root,dataset* ds,char* classfield,tree_options* opts,fit_state* st,tree_rng rng,int depth,int* counts);
+
+void __fit_task(void* arg)
+{
+    fit_task* task=arg;
+    _fit_tree(task->root,task->ds,task->classfield,task->opts,task->st,task->rng,task->depth,task->counts);
+}
+
+/*
+Fits the subtree at <root>, whose lines have the class counts <counts>.
+Every node gets its own random number generator (seeded by its parent), so the tree doesn't depend on the order
+the nodes are fitted in.
+*/
+void _fit_tree(tree_node** root,dataset* ds,char* classfield,tree_options* opts,fit_state* st,tree_rng rng,int depth,int* counts)
+{
+    dataset_cache* c=get_cache(ds);
+    int i,j,mi,len=0,n=c->rows,words=MASK_WORDS(n),*sizes=NULL,*child_counts=NULL,*map;
+    unsigned long long* masks=NULL,*classrows,*subset=NULL;
+    task_group group;
+    fit_task* tasks;
+    label* l=NULL;
+    double impurity,pt=0;
+    dataset** subsets=NULL;
+    tree_ll* working=NULL;
+    arena* scratch=NULL;
+    *root=malloc(sizeof(tree_node));
+    (*root)->partition=0;
+    (*root)->subtrees=NULL;
+    (*root)->oob=NULL;
+    (*root)->subset=NULL;
+    impurity=__impurity(&st->score,counts,st->classes,n);
+    /*Pure nodes and nodes beyond the growth limits become leaves*/
+    if(!impurity||n<opts->min_samples_split||(opts->max_depth>0&&depth>=opts->max_depth)||
+        (opts->max_leaves>0&&__atomic_load_n(&st->leaves,__ATOMIC_ACQUIRE)>=opts->max_leaves))goto leaf;
+    if(!choose_split(ds,n,classfield,impurity,opts,st,&rng,&l,&mi,&pt,&subset))goto leaf;
+    /*The lines of each child, as bitmaps*/
+    len=l->type==LABEL_NUM||subset?2:ll_len(&l->sublabels);
+    /*Everything the node needs while its children are fitted goes on one arena, freed all at once: the masks, counts and
+    tasks, and for each child, the list of its lines (which split the node's <n> lines) and their indexes*/
+    scratch=arena_create((sizeof(unsigned long long)*words+sizeof(int)*(st->classes+1)+sizeof(fit_task)+sizeof(dataset*)+
+        64)*len+(sizeof(int)*2+sizeof(tree_ll))*n+64*7);
+    masks=arena_alloc(scratch,sizeof(unsigned long long)*(len*words+1));
+    if(l->type==LABEL_NUM)
+    {
+        mask_num(cache_values(ds,mi),n,pt,masks);
+        for(i=0;i<words;i++)masks[words+i]=~masks[i];
+        if(n%64)masks[2*words-1]&=(1ULL<<(n%64))-1;
+    }
+    else if(subset)mask_codes_in(cache_codes(ds,mi),n,subset,masks,masks+words);
+    else for(i=0;i<len;i++)mask_code(cache_codes(ds,mi),n,i,masks+i*words);
+    /*Their class counts come from intersecting them with the lines of each class, so nothing is built until the split is accepted*/
+    classrows=cache_label_rows(ds,st->classindex);
+    sizes=arena_alloc(scratch,sizeof(int)*len);
+    child_counts=arena_alloc(scratch,sizeof(int)*(len*st->classes+1));
+    for(i=0;i<len;i++)
+    {
+        sizes[i]=mask_count(masks+i*words,n);
+        for(j=0;j<st->classes;j++)child_counts[i*st->classes+j]=mask_and_count(masks+i*words,classrows+j*words,n);
+    }
+    /*Every child needs some lines*/
+    for(i=0;i<len;i++)if(sizes[i]<(opts->min_samples_leaf>1?opts->min_samples_leaf:1))goto discard;
+    /*Chi-squared test*/
+    if(chi_squared_counts(counts,child_counts,len,st->classes)<opts->chi_square_significance_limit)goto discard;
+    /*And the new leaves must fit in the tree*/
+    if(!reserve_leaves(st,opts->max_leaves,len-1))goto discard;
+    /*If the division is not statistically insignificant, we can keep it*/
+    (*root)->attribute=l;
+    (*root)->partition=pt;
+    (*root)->subset=subset;
+    subsets=arena_alloc(scratch,sizeof(dataset*)*len);
+    /*The children take the columns they need from the node's cache, through one map of the node's lines for all of them*/
+    map=arena_alloc(scratch,sizeof(int)*(n?n:1));
+    for(i=0;i<len;i++)subsets[i]=__mask_subset(ds,c,masks+i*words,1,scratch,map);
+    task_group_init(&group);
+    tasks=arena_alloc(scratch,sizeof(fit_task)*len);
+    for(i=0;i<len;i++)
+    {
+        working=ll_push(working?&working:&(*root)->subtrees,NULL);
+        tasks[i].root=(tree_node**)&working->self;
+        tasks[i].ds=subsets[i];
+        tasks[i].classfield=classfield;
+        tasks[i].opts=opts;
+        tasks[i].st=st;
+        rng_seed(&tasks[i].rng,rng_next(&rng));
+        tasks[i].depth=depth+1;
+        tasks[i].counts=child_counts+i*st->classes;
+        /*Big subtrees are fitted as tasks (that idle threads may steal), small ones right away*/
+        if(st->pool&&sizes[i]>=opts->parallel_cutoff)thread_pool_spawn(st->pool,&group,__fit_task,&tasks[i]);
+        else __fit_task(&tasks[i]);
+    }
+    if(st->pool)thread_pool_wait(st->pool,&group);
+    for(i=0;i<len;i++)__free_subset(&subsets[i]);
+    arena_free(&scratch);
+    return;
+    discard:
+    arena_free(&scratch);
+    free(subset);
+    leaf:
+    /*We choose the biggest count and set ourselves as a leaf node*/
+    l=NULL;
+    for(i=0,mi=0;i<st->classes;i++)
+    {
+        if(counts[i]>mi)
+        {
+            mi=counts[i];
+            l=select_label_by_index(st->classlabel->sublabels,i);
+        }
+    }
+    (*root)->attribute=l;
+    (*root)->partition=0;
+}
+
+void fit_tree_mode(tree_node** root,dataset* ds,char* classfield,tree_options* opts,char mode)
+{
+    if(!root||!ds)return;
+    int i,*counts;
+    fit_state st;
+    tree_options defaults;
+    tree_ll* lab;
+    tree_rng rng;
+    if(!opts)
+    {
+        tree_options_init(&defaults);
+        opts=&defaults;
+    }
+    st.classlabel=select_label(ds->col_labels,classfield);
+    st.classindex=select_label_index(ds->col_labels,classfield);
+    st.mode=mode;
+    st.leaves=1;
+    st.subset_words=opts->binary_categorical?1:0;
+    if(!st.classlabel)
+    {
+        printf("KeyError: Field \"%s\" does not exist in dataset. Could not fit tree.\n",classfield);
+        return;
+    }
+    st.classes=ll_len(&st.classlabel->sublabels);
+    st.cols=ll_len(&ds->col_labels);
+    st.columns=malloc(sizeof(label*)*st.cols);
+    lab=ds->col_labels;
+    for(i=0;i<st.cols;i++)
+    {
+        st.columns[i]=lab->self;
+        lab=lab->next;
+        if(st.subset_words&&i!=st.classindex&&st.columns[i]->type==LABEL_CAT&&MASK_WORDS(ll_len(&st.columns[i]->sublabels))>st.subset_words)
+            st.subset_words=MASK_WORDS(ll_len(&st.columns[i]->sublabels));
+    }
+    st.pool=(opts->threads<0||opts->threads>1)?thread_pool_create(opts->threads<0?0:opts->threads):NULL;
+    rng_seed(&rng,opts->seed?opts->seed:(unsigned long long)rand());
+    counts=malloc(sizeof(int)*(st.classes?st.classes:1));
+    class_counts(ds,st.classindex,st.classes,counts);
+    __score_init(&st.score,opts->criterion,get_cache(ds)->rows);
+    /*Every column is read from the lines in a single walk, so the nodes take the columns they look at from their parents
+    instead of walking the lines of their subsets for each*/
+    cache_fill(ds);
+    _fit_tree(root,ds,classfield,opts,&st,rng,0,counts);
+    __score_free(&st.score);
+    thread_pool_free(&st.pool);
+    free(st.columns);
+    free(counts);
+}
+
+void fit_tree_opts(tree_node** root,dataset* ds,char* classfield,tree_options* opts)
+{
+    fit_tree_mode(root,ds,classfield,opts,FIT_BEST);
+}
+
+void fit_random_tree_opts(tree_node** root,dataset* ds,char* classfield,tree_options* opts)
+{
+    fit_tree_mode(root,ds,classfield,opts,FIT_RANDOM);
+}
+
+void fit_extra_tree_opts(tree_node** root,dataset* ds,char* classfield,tree_options* opts)
+{
+    fit_tree_mode(root,ds,classfield,opts,FIT_EXTRA);
+}
+
+void fit_tree(tree_node** root,dataset* ds,double chi_square_significance_limit,char* classfield)
+{
+    tree_options opts;
+    tree_options_init(&opts);
+    opts.chi_square_significance_limit=chi_square_significance_limit;
+    fit_tree_opts(root,ds,classfield,&opts);
+}
+
+void fit_random_tree(tree_node** root,dataset* ds,double chi_square_significance_limit,char* classfield)
+{
+    tree_options opts;
+    tree_options_init(&opts);
+    opts.chi_square_significance_limit=chi_square_significance_limit;
+    fit_random_tree_opts(root,ds,classfield,&opts);
+}
+
+void fit_extra_tree(tree_node** root,dataset* ds,double chi_square_significance_limit,char* classfield)
+{
+    tree_options opts;
+    tree_options_init(&opts);
+    opts.chi_square_significance_limit=chi_square_significance_limit;
+    fit_extra_tree_opts(root,ds,classfield,&opts);
+}
+
+int tree_size(tree_node* root)
+{
+    int s=1;
+    if(!root)return 0;
+    tree_ll* subtree=root->subtrees;
+    foreach(subtree,
+    {
+        s+=tree_size(subtree->self);
+    });
+    return s;
+}
+
+tree_node* clone_tree(tree_node* root)
+{
+    if(!root)return NULL;
+    tree_node* ret=malloc(sizeof(tree_node));
+    tree_ll* subtree,*tail=NULL;
+    ret->attribute=root->attribute;
+    ret->partition=root->partition;
+    ret->subtrees=NULL;
+    ret->oob=NULL;
+    ret->subset=NULL;
+    if(root->subset)
+    {
+        ret->subset=malloc(sizeof(unsigned long long)*(MASK_WORDS((int)root->partition)+1));
+        memcpy(ret->subset,root->subset,sizeof(unsigned long long)*MASK_WORDS((int)root->partition));
+    }
+    subtree=root->oob;
+    foreach(subtree,{
+        tail=ll_push(tail?&tail:&ret->oob,subtree->self);
+    });
+    subtree=root->subtrees;
+    foreach(subtree,{
+        ll_push(&ret->subtrees,clone_tree(subtree->self));
+    });
+    return ret;
+}
+
+void free_tree(tree_node** root)
+{
+    if(!root||!(*root))return;
+    tree_ll* subtree=(*root)->subtrees;
+    foreach(subtree,{
+        free_tree((tree_node**)&subtree->self);
+    });
+    ll_free(&(*root)->subtrees);
+    ll_free(&(*root)->oob);
+    free((*root)->subset);
+    free(*root);
+    *root=NULL;
+}
+
+double _prune_tree(tree_node** root,dataset* ds,char* classfield,tree_node* orig_tree)
+{
+    double score=0,pscore=0;
+    unsigned int idx=0;
+    label* leaf=NULL;
+    char all_leaves=1,all_eq=1,prune_anyways=0;
+    tree_ll* subtree,*subsubtree;
+    tree_node bkp;
+    dataset* subset;
+    f_numberfilter numconf;
+    f_namefilter namconf;
+    if(!root||!(*root)||!(*root)->subtrees||!ds||!ds->lines)return 0;
+    pscore=tree_score(orig_tree,ds,classfield);
+    subtree=(*root)->subtrees;
+    foreach(subtree,{
+        if((subsubtree=((tree_node*)(subtree->self))->subtrees))
+        {
+            all_leaves=0;
+            foreach(subsubtree,({
+                if(((tree_node*)subsubtree->self)->attribute->type==LABEL_NUM)
+                {
+                    numconf.bt=idx;
+                    numconf.field_index=select_label_index(ds->col_labels,((tree_node*)subsubtree->self)->attribute->name);
+                    numconf.target=((tree_node*)subsubtree->self)->partition;
+                    subset=filter_dataset(ds,f_by_number,&numconf);
+                }
+                else
+                {
+                    namconf.field_index=select_label_index(ds->col_labels,((tree_node*)subsubtree->self)->attribute->name);
+                    namconf.target=select_label_by_index(((tree_node*)subsubtree->self)->attribute->sublabels,idx);
+                    subset=filter_dataset(ds,f_by_name,&namconf);
+                }
+                if(!subset->lines){
+                    prune_anyways=1;
+                    free_dataset(&subset);
+                    break;
+                }
+                while(prune_tree((tree_node**)&subsubtree->self,subset,classfield));
+                free_dataset(&subset);
+            }));
+        }
+        else
+        {
+            if(all_eq)
+            {
+                if(leaf)
+                {
+                    all_eq=all_eq&&((tree_node*)(subtree->self))->attribute==leaf;
+                }
+                else
+                {
+                    leaf=((tree_node*)(subtree->self))->attribute;
+                }
+            }
+        }
+        idx++;
+    });
+    if(all_leaves)
+    {
+        if(all_eq)
+        {
+            subtree=(*root)->subtrees;
+            foreach(subtree,{
+                free(subtree->self);
+            });
+            ll_free(&(*root)->subtrees);
+            free((*root)->subset);
+            (*root)->subset=NULL;
+            (*root)->partition=0;
+            (*root)->attribute=leaf;
+            return -1;
+        }
+        else
+        {
+            bkp=**root;
+            (*root)->attribute=most_frequent_class(&bkp,ds,classfield);
+            (*root)->partition=0;
+            (*root)->subtrees=NULL;
+            (*root)->subset=NULL;
+            score=tree_score(orig_tree,ds,classfield);
+            if(score<pscore)
+            {
+                **root=bkp;
+            }
+            else
+            {
+                ll_free_self(&bkp.subtrees);
+                free(bkp.subset);
+            }
+        }
+    }
+    else if(prune_anyways)
+    {
+        bkp=**root;
+        (*root)->attribute=most_frequent_class(&bkp,ds,classfield);
+        (*root)->partition=0;
+        (*root)->subtrees=NULL;
+        (*root)->subset=NULL;
+        score=tree_score(orig_tree,ds,classfield);
+        if(score<pscore)
+        {
+            **root=bkp;
+        }
+        else
+        {
+            /*Unlike above, the children may have subtrees of their own*/
+            subtree=bkp.subtrees;
+            foreach(subtree,{
+                free_tree((tree_node**)&subtree->self);
+            });
+            ll_free(&bkp.subtrees);
+            free(bkp.subset);
+        }
+    }
+    else return 0;
+    score=tree_score(orig_tree,ds,classfield);
+    return pscore-score;
+}
+
+double prune_tree(tree_node** root,dataset* ds,char* classfield)
+{
+    double prev=0,cur;
+    while((cur=_prune_tree(root,ds,classfield,*root)))prev=cur;
+    return prev;
+}
+
+label* classify(tree_node* root,tree_ll* line,tree_ll* columns)
+{
+    if(!root||!line)return NULL;
+    if(!root->subtrees)return root->attribute;
+    int idx=0,i;
+    tree_ll* lab=columns,*subtree,*entry;
+    while(lab)
+    {
+        if(strncmp(((label*)lab->self)->name,root->attribute->name,64)==0)goto found;
+        lab=lab->next;
+        idx++;
+    }
+    return NULL;
+    found:
+    if(root->attribute->type==LABEL_NUM)
+    {
+        lab=line;
+        for(i=0;i<idx;i++)lab=lab->next;
+        if(*(double*)lab->self<=root->partition)
+        {
+            return classify(root->subtrees->self,line,columns);
+        }
+        else return classify(root->subtrees->next->self,line,columns);
+    }
+    else if(root->subset)
+    {
+        entry=line;
+        for(i=0;i<idx;i++)entry=entry->next;
+        if((i=sublabel_index(root->attribute->sublabels,entry->self))<0||i>=root->partition)return NULL;
+        subtree=(root->subset[i/64]>>(i%64))&1?root->subtrees:root->subtrees->next;
+        return classify(subtree->self,line,columns);
+    }
+    else
+    {
+        lab=root->attribute->sublabels;
+        entry=line;
+        for(i=0;i<idx;i++){entry=entry->next;}
+        subtree=root->subtrees;
+        while(lab)
+        {
+            if(entry->self==lab->self)return classify(subtree->self,line,columns);
+            lab=lab->next;
+            subtree=subtree->next;
+        }
+    }
+    return NULL;
+}
+
+double tree_score(tree_node* root,dataset* ds,char* classfield)
+{
+    int tests=ll_len(&ds->lines),right=0;
+    tree_ll* line;
+    label* lab;
+    line=ds->lines;
+    while(line)
+    {
+        lab=classify(root,line->self,ds->col_labels);
+        right+=get_entry_by_label_name(line->self,ds->col_labels,classfield)==lab;
+        line=line->next;
+    }
+    return (double)right/(double)tests;
+}
+
+void _print_tree(tree_node* root,int l)
+{
+    if(!root)return;
+    int i,j;
+    char first;
+    tree_ll* curtree,*curatt;
+    for(i=0;i<l;i++)printf("\t");
+    printf("[%s]",root->attribute->name);
+    curtree=root->subtrees;
+    if(!curtree)printf("*\n");
+    else
+    {
+        printf("\n");
+        if(root->attribute->type==LABEL_NUM)
+        {
+            for(i=0;i<l;i++)printf("\t");
+            printf("  <=(%.2lf)->\n",root->partition);
+            _print_tree(curtree->self,l+1);
+            curtree=curtree->next;
+            for(i=0;i<l;i++)printf("\t");
+            printf("   >(%.2lf)->\n",root->partition);
+            _print_tree(curtree->self,l+1);
+        }
+        else if(root->subset)
+        {
+            /*The sublabels of each side*/
+            for(j=0;j<2;j++,curtree=curtree->next)
+            {
+                for(i=0;i<l;i++)printf("\t");
+                printf("  (");
+                for(curatt=root->attribute->sublabels,i=0,first=1;curatt&&i<root->partition;curatt=curatt->next,i++)
+                {
+                    if(((root->subset[i/64]>>(i%64))&1)==j)continue;
+                    printf("%s%s",first?"":"|",((label*)curatt->self)->name);
+                    first=0;
+                }
+                printf(")->\n");
+                _print_tree(curtree->self,l+1);
+            }
+        }
+        else
+        {
+            curatt=root->attribute->sublabels;
+            while(curtree)
+            {
+                for(i=0;i<l;i++)printf("\t");
+                printf("  (%s)->\n",((label*)curatt->self)->name);
+                _print_tree(curtree->self,l+1);
+                curtree=curtree->next;
+                curatt=curatt->next;
+            }
+        }
+    }
+}
+void print_tree(tree_node* root)
+{
+    if(!root)return;
+    _print_tree(root,0);
+}
+
+/*
+Forests
+*/
+
+/*
+Out-of-bag bookkeeping.
+Each tree classifies its out-of-bag lines once and its votes are kept on a table, so the forest's out-of-bag score
+can be recomputed without classifying anything when a tree is added or taken away.
+*/
+
+typedef struct _oob_row{
+    void* line;
+    int idx;
+}oob_row;
+
+typedef struct _oob_tree{
+    tree_node* tree;
+    int len;/*Number of out-of-bag lines of the tree that were found on the dataset*/
+    int* rows;/*Their indexes on the dataset*/
+    int* classes;/*And the class index the tree gave them (-1 if it couldn't classify them)*/
+}oob_tree;
+
+typedef struct _oob_table{
+    int rows,classes,trees;
+    int* truth;/*Class index of each line*/
+    int* votes;/*rows*classes vote counts*/
+    oob_tree* tree;
+}oob_table;
+
+int __oob_rowcmp(const void* a,const void* b)
+{
+    void *va=((oob_row*)a)->line,*vb=((oob_row*)b)->line;
+    return (va>vb)?1:(va==vb?0:-1);
+}
+
+char __find_pointer(void* item,void* arg)
+{
+    return item==arg;
+}
+
+oob_table* oob_table_build(forest a,dataset* ds,char* classfield)
+{
+    if(!ds)return NULL;
+    label* classlabel=select_label(ds->col_labels,classfield);
+    int cidx=select_label_index(ds->col_labels,classfield),i,j,len;
+    if(!classlabel||classlabel->type!=LABEL_CAT)return NULL;
+    oob_table* ret=malloc(sizeof(oob_table));
+    oob_row* index,key,*found;
+    tree_ll* line,*entry;
+    ret->rows=ll_len(&ds->lines);
+    ret->classes=ll_len(&classlabel->sublabels);
+    ret->trees=ll_len(&a);
+    ret->truth=malloc(sizeof(int)*(ret->rows?ret->rows:1));
+    ret->votes=calloc(ret->rows*ret->classes+1,sizeof(int));
+    ret->tree=malloc(sizeof(oob_tree)*(ret->trees?ret->trees:1));
+    index=malloc(sizeof(oob_row)*(ret->rows?ret->rows:1));
+    /*Lines are looked up by address, so we sort them once*/
+    line=ds->lines;
+    for(i=0;i<ret->rows;i++)
+    {
+        index[i].line=line->self;
+        index[i].idx=i;
+        entry=line->self;
+        for(j=0;j<cidx;j++)entry=entry->next;
+        ret->truth[i]=sublabel_index(classlabel->sublabels,entry->self);
+        line=line->next;
+    }
+    qsort(index,ret->rows,sizeof(oob_row),__oob_rowcmp);
+    for(i=0;i<ret->trees;i++)
+    {
+        ret->tree[i].tree=a->self;
+        len=ll_len(&ret->tree[i].tree->oob);
+        ret->tree[i].len=0;
+        ret->tree[i].rows=malloc(sizeof(int)*(len?len:1));
+        ret->tree[i].classes=malloc(sizeof(int)*(len?len:1));
+        line=ret->tree[i].tree->oob;
+        foreach(line,{
+            key.line=line->self;
+            if((found=bsearch(&key,index,ret->rows,sizeof(oob_row),__oob_rowcmp)))
+            {
+                len=ret->tree[i].len++;
+                ret->tree[i].rows[len]=found->idx;
+                ret->tree[i].classes[len]=sublabel_index(classlabel->sublabels,classify(ret->tree[i].tree,line->self,ds->col_labels));
+                if(ret->tree[i].classes[len]>=0)ret->votes[found->idx*ret->classes+ret->tree[i].classes[len]]++;
+            }
+        });
+        a=a->next;
+    }
+    free(index);
+    return ret;
+}
+
+/*Adds (<delta>=1) or takes back (<delta>=-1) the votes of the <i>th tree*/
+void oob_table_vote(oob_table* t,int i,int delta)
+{
+    int j;
+    for(j=0;j<t->tree[i].len;j++)
+        if(t->tree[i].classes[j]>=0)t->votes[t->tree[i].rows[j]*t->classes+t->tree[i].classes[j]]+=delta;
+}
+
+double oob_table_score(oob_table* t)
+{
+    int i,j,imax,voted=0,right=0,*votes;
+    for(i=0;i<t->rows;i++)
+    {
+        votes=&t->votes[i*t->classes];
+        imax=0;
+        for(j=1;j<t->classes;j++)if(votes[j]>votes[imax])imax=j;
+        if(t->classes==0||votes[imax]==0)continue;
+        voted++;
+        right+=imax==t->truth[i];
+    }
+    return voted?(double)right/(double)voted:0;
+}
+
+void oob_table_free(oob_table* t)
+{
+    int i;
+    if(!t)return;
+    for(i=0;i<t->trees;i++)
+    {
+        free(t->tree[i].rows);
+        free(t->tree[i].classes);
+    }
+    free(t->tree);
+    free(t->truth);
+    free(t->votes);
+    free(t);
+}
+
+/*Takes a tree's node out of the forest*/
+void forest_remove(forest* a,tree_ll* node)
+{
+    if(node->prev)node->prev->next=node->next;
+    else *a=node->next;
+    if(node->next)node->next->prev=node->prev;
+    free(node);
+}
+
+double fit_forest_opts(forest* a,dataset* ds,char* classfield,int max_size,double subset_relative_size,
+    tree_fitter fitter,tree_options* opts,char oob)
+{
+    int i,slen;
+    if(!a||!ds||max_size==0||((slen=ll_len(&ds->lines)*subset_relative_size)==0))return 0;
+    dataset* subset,*pruning_subset,*oob_subset=NULL;
+    tree_node* current_tree;
+    tree_ll* tree,*next;
+    oob_table* table;
+    tree_options tree_opts;
+    tree_rng rng;
+    double score,pscore;
+    if(opts)tree_opts=*opts;
+    else tree_options_init(&tree_opts);
+    rng_seed(&rng,tree_opts.seed?tree_opts.seed:(unsigned long long)rand());
+    pscore=oob?forest_oob_score(*a,ds,classfield):forest_score(*a,ds,classfield);
+    /*First we fill the forest up to the maximum size*/
+    for(i=ll_len(a);i<max_size;i++)
+    {
+        if(oob)
+        {
+            /*The pruning lines are taken from the sample itself, so everything else stays out-of-bag*/
+            subset=sample_dataset_r(ds,slen,classfield,&oob_subset,&rng);
+            pruning_subset=sample_dataset_r(subset,ll_len(&subset->lines)/2,classfield,NULL,&rng);
+        }
+        else
+        {
+            subset=sample_dataset_r(ds,slen,classfield,NULL,&rng);
+            pruning_subset=sample_dataset_r(ds,slen,classfield,NULL,&rng);
+        }
+        current_tree=NULL;
+        fflush(stdout);
+
+        /*Every tree gets its own seed*/
+        tree_opts.seed=rng_next(&rng)|1;
+        fitter(&current_tree,subset,classfield,&tree_opts);
+        prune_tree(&current_tree,pruning_subset,classfield);
+
+        if(oob_subset)
+        {
+            current_tree->oob=oob_subset->lines;
+            oob_subset->lines=NULL;
+            free_dataset(&oob_subset);
+        }
+        ll_push(a,current_tree);
+
+        free_dataset(&subset);
+        if(pruning_subset)
+        {
+            free_dataset(&pruning_subset);
+        }
+    }
+    /*Then we chop down the trees that hinder its performance*/
+    if(oob)
+    {
+        /*On the out-of-bag lines*/
+        if(!(table=oob_table_build(*a,ds,classfield)))return 0;
+        for(i=0;i<table->trees;i++)
+        {
+            /*Trees without out-of-bag lines can't be judged here*/
+            if(!table->tree[i].tree->oob)continue;
+            score=oob_table_score(table);
+            oob_table_vote(table,i,-1);
+            if(score>oob_table_score(table))oob_table_vote(table,i,1);
+            else
+            {
+                forest_remove(a,ll_search(a,__find_pointer,table->tree[i].tree));
+                free_tree(&table->tree[i].tree);
+            }
+        }
+        score=oob_table_score(table);
+        oob_table_free(table);
+        return score-pscore;
+    }
+    /*Or on the full dataset*/
+    tree=*a;
+    while(tree)
+    {
+        next=tree->next;
+        score=forest_score(*a,ds,classfield);
+        current_tree=tree->self;
+        forest_remove(a,tree);
+        if(score>forest_score(*a,ds,classfield))
+        {
+            *a=ll_push_reverse(a,current_tree);
+        }
+        else free_tree(&current_tree);
+        tree=next;
+    }
+    return forest_score(*a,ds,classfield)-pscore;
+}
+
+double fit_forest(forest* a,dataset* ds,char* classfield,int max_size,double subset_relative_size)
+{
+    return fit_forest_opts(a,ds,classfield,max_size,subset_relative_size,fit_tree_opts,NULL,0);
+}
+
+double fit_random_forest(forest* a,dataset* ds,char* classfield,int max_size,double subset_relative_size)
+{
+    return fit_forest_opts(a,ds,classfield,max_size,subset_relative_size,fit_random_tree_opts,NULL,0);
+}
+
+double fit_extra_forest(forest* a,dataset* ds,char* classfield,int max_size,double subset_relative_size)
+{
+    return fit_forest_opts(a,ds,classfield,max_size,subset_relative_size,fit_extra_tree_opts,NULL,0);
+}
+
+double fit_forest_oob(forest* a,dataset* ds,char* classfield,int max_size,double subset_relative_size)
+{
+    return fit_forest_opts(a,ds,classfield,max_size,subset_relative_size,fit_tree_opts,NULL,1);
+}
+
+double fit_random_forest_oob(forest* a,dataset* ds,char* classfield,int max_size,double subset_relative_size)
+{
+    return fit_forest_opts(a,ds,classfield,max_size,subset_relative_size,fit_random_tree_opts,NULL,1);
+}
+
+label* forest_classify(forest a,tree_ll* line,tree_ll* columns)
+{
+    tree_ll* frequencies=NULL,*labels=NULL,*current,*current_label;
+    label* class,*ret=NULL;
+    int idx,max=0;
+    foreach(a,
+    {
+        /*Trees that can't follow the line (because of a label they weren't fitted with) don't vote*/
+        if((class=classify(a->self,line,columns)))
+        {
+            idx=select_label_index(labels,class->name);
+            if(idx==-1)
+            {
+                idx=ll_len(&labels);
+                ll_push(&labels,class);
+                ll_push(&frequencies,calloc(1,sizeof(unsigned int)));
+            }
+            (*(unsigned int*)select_by_index(frequencies,idx))++;
+        }
+    });
+    current=frequencies;
+    current_label=labels;
+    foreach(current,{
+        if(*(unsigned int*)current->self>max)
+        {
+            max=*(unsigned int*)current->self;
+            ret=current_label->self;
+        }
+        current_label=current_label->next;
+    });
+    ll_free(&labels);
+    ll_free_self(&frequencies);
+    return ret;
+}
+
+long forest_predict_csv(forest a,tree_ll* columns,const char* fname,FILE* out,int rows)
+{
+    if(!a||!columns||!out)return -1;
+    csv_reader* reader=csv_reader_open(fname,columns);
+    dataset* batch;
+    tree_ll* line;
+    label* class;
+    long ret=0;
+    if(!reader)return -1;
+    /*Only one batch is held at a time*/
+    while((batch=csv_read_batch(reader,rows)))
     {
-        mi=rand()%ll_len(&lab);
-        l=select_label_by_index(lab,mi);
-        if(strcmp(l->name,classfield))
+        for(line=batch->lines;line;line=line->next)
         {
-            if(l->type==LABEL_NUM)
-            {
-                thresh=optimize_threshold(ds,((label*)lab->self)->name,classfield);
-                gain=entropy-attribute_num_entropy(ds,((label*)lab->self)->name,classfield,thresh);
-            }
-            else
-            {
-                gain=entropy-attribute_entropy(ds,((label*)lab->self)->name,classfield);
-            }
-            if(gain<=0)goto leaf;
+            class=forest_classify(a,line->self,batch->col_labels);
+            fprintf(out,"%s\n",class?class->name:"");
+            ret++;
         }
-        else l=NULL;
+        csv_free_batch(&batch);
     }
-    *root=malloc(sizeof(tree_node));
-    if(!l||!entropy)
+    if(csv_reader_failed(reader))ret=-1;
+    csv_reader_close(&reader);
+    return ret;
+}
+
+/*Index of the class called <class> on <f>, adding it if it's new*/
+int __compiled_class(compiled_forest* f,label* class)
+{
+    int i;
+    for(i=0;i<f->class_count;i++)if(strncmp(f->classes[i]->name,class->name,64)==0)return i;
+    f->classes=realloc(f->classes,sizeof(label*)*(f->class_count+1));
+    f->classes[f->class_count]=class;
+    return f->class_count++;
+}
+
+/*Column of <columns> that <root> decides upon, or -1 if <root> is a leaf or can't follow lines of <columns>*/
+int __compiled_column(compiled_forest* f,tree_node* root,tree_ll* columns)
+{
+    int ret;
+    if(!root->subtrees||(ret=select_label_index(columns,root->attribute->name))<0)return -1;
+    /*Numerical columns have no codes, so the kind of the node must match the kind of the column*/
+    if((root->attribute->type==LABEL_NUM)!=(f->codes[ret]==0))return -1;
+    /*Binary splits number the codes by the node's sublabels, so they must be the column's*/
+    if(root->subset&&(select_by_index(columns,ret)!=root->attribute||f->codes[ret]!=root->partition))return -1;
+    return ret;
+}
+
+/*Number of nodes <root> compiles to*/
+int __compiled_size(compiled_forest* f,tree_node* root,tree_ll* columns)
+{
+    int col=__compiled_column(f,root,columns),ret=1,i;
+    label* column;
+    tree_ll* sub,*node_sub,*subtree;
+    if(col<0)return 1;
+    if(root->attribute->type==LABEL_NUM||root->subset)
+        return 1+__compiled_size(f,root->subtrees->self,columns)+__compiled_size(f,root->subtrees->next->self,columns);
+    column=select_by_index(columns,col);
+    for(i=0,sub=column->sublabels;sub;sub=sub->next,i++)
     {
-        /*We choose the biggest count and set ourselves as a leaf node*/
-        goto leaf;
+        /*A category missing from the node compiles to a leaf that can't classify*/
+        for(node_sub=root->attribute->sublabels,subtree=root->subtrees;node_sub&&node_sub->self!=sub->self;
+            node_sub=node_sub->next,subtree=subtree->next);
+        ret+=node_sub?__compiled_size(f,subtree->self,columns):1;
     }
-    if(l->type==LABEL_NUM)
+    return ret;
+}
+
+/*Compiles <root> to the node <idx> of <t>, placing its children from node *<next> on (and moving *<next> past them)*/
+void __compile_node(compiled_forest* f,tree_node* root,tree_ll* columns,flat_tree* t,int idx,int* next)
+{
+    flat_node* n=&t->nodes[idx],*nodes=t->nodes;
+    int col=__compiled_column(f,root,columns),i,words;
+    label* column;
+    tree_ll* sub,*node_sub,*subtree;
+    n->column=col;
+    n->partition=0;
+    if(col<0)
     {
-        (*root)->attribute=l;
-        (*root)->partition=thresh;
-        (*root)->subtrees=NULL;
-        subsets=malloc(sizeof(dataset*)*2);
-        nuconf.bt=0;
-        nuconf.field_index=mi;
-        nuconf.target=thresh;
-        subsets[0]=filter_dataset(ds,f_by_number,&nuconf);
-        nuconf.bt=1;
-        subsets[1]=filter_dataset(ds,f_by_number,&nuconf);
-        if(ll_len(&subsets[0]->lines)==0||ll_len(&subsets[1]->lines)==0)
-        {
-            ll_free(&subsets[0]->lines);
-            ll_free(&subsets[1]->lines);
-            free(subsets[0]);
-            free(subsets[1]);
-            goto leaf;
-        }
-
-        /*Chi-squared test*/
-        if(chi_squared(ds,subsets,2,classlabel->self)<chi_square_significance_limit)
-        {
-            /*If it doesn't pass the test, we choose the biggest count and set ourselves as a leaf node*/
-            ll_free(&subsets[0]->lines);
-            ll_free(&subsets[1]->lines);
-            free(subsets[0]);
-            free(subsets[1]);
-            goto leaf;
+        /*Leaves keep the index of their class, and nodes that can't be followed classify as nothing*/
+        n->child=!root->subtrees&&root->attribute?__compiled_class(f,root->attribute):-1;
+        return;
+    }
+    n->child=*next;
+    if(root->attribute->type==LABEL_NUM||root->subset)
+    {
+        n->partition=root->partition;
+        if(root->subset)
+        {
+            /*The bitset goes to the end of the tree's*/
+            words=MASK_WORDS(f->codes[col]);
+            t->subsets=realloc(t->subsets,sizeof(unsigned long long)*(t->words+words));
+            memcpy(t->subsets+t->words,root->subset,sizeof(unsigned long long)*words);
+            n->partition=1+t->words;
+            t->words+=words;
         }
+        *next+=2;
+        __compile_node(f,root->subtrees->self,columns,t,n->child,next);
+        __compile_node(f,root->subtrees->next->self,columns,t,n->child+1,next);
+        return;
+    }
+    column=select_by_index(columns,col);
+    *next+=f->codes[col];
+    for(i=0,sub=column->sublabels;sub;sub=sub->next,i++)
+    {
+        for(node_sub=root->attribute->sublabels,subtree=root->subtrees;node_sub&&node_sub->self!=sub->self;
+            node_sub=node_sub->next,subtree=subtree->next);
+        if(node_sub)__compile_node(f,subtree->self,columns,t,n->child+i,next);
         else
         {
-            /*If the division is not statistically insignificant, we can keep it*/
-            ll_push(&(*root)->subtrees,malloc(sizeof(tree_node*)));
-            fit_tree((tree_node**)&(*root)->subtrees->self,subsets[0],chi_square_significance_limit,classfield);
-            ll_push(&(*root)->subtrees,malloc(sizeof(tree_node*)));
-            fit_tree((tree_node**)&(*root)->subtrees->next->self,subsets[1],chi_square_significance_limit,classfield);
-            ll_free(&subsets[0]->lines);
-            ll_free(&subsets[1]->lines);
-            free(subsets[0]);
-            free(subsets[1]);
+            nodes[n->child+i].column=-1;
+            nodes[n->child+i].child=-1;
+            nodes[n->child+i].partition=0;
         }
     }
-    else
+}
+
+compiled_forest* forest_compile(forest a,tree_ll* columns)
+{
+    if(!a||!columns)return NULL;
+    compiled_forest* ret=malloc(sizeof(compiled_forest));
+    tree_ll* col;
+    int i,next;
+    ret->cols=ll_len(&columns);
+    ret->codes=malloc(sizeof(int)*ret->cols);
+    for(col=columns,i=0;col;col=col->next,i++)
+        ret->codes[i]=((label*)col->self)->type==LABEL_NUM?0:ll_len(&((label*)col->self)->sublabels);
+    ret->len=ll_len(&a);
+    ret->trees=malloc(sizeof(flat_tree)*ret->len);
+    ret->classes=NULL;
+    ret->class_count=0;
+    ret->layout=LAYOUT_DEPTH_FIRST;
+    for(i=0;a;a=a->next,i++)
     {
-        (*root)->attribute=l;
-        (*root)->partition=0;
-        (*root)->subtrees=NULL;
-        len=ll_len(&l->sublabels);
-        lab=l->sublabels;
-        subsets=malloc(sizeof(dataset*)*len);
-        naconf.field_index=mi;
-        for(i=0;i<len;i++)
+        ret->trees[i].len=__compiled_size(ret,a->self,columns);
+        ret->trees[i].nodes=malloc(sizeof(flat_node)*ret->trees[i].len);
+        ret->trees[i].subsets=NULL;
+        ret->trees[i].words=0;
+        next=1;
+        __compile_node(ret,a->self,columns,&ret->trees[i],0,&next);
+    }
+    return ret;
+}
+
+/*
+Child (from the first) that code <code> leads to from the categorical node <n> of <t>: the code itself, or for binary
+splits, 0 if it's on the node's bitset and 1 if it isn't
+*/
+#define FLAT_BRANCH(t,n,code) ((n)->partition?!(((t)->subsets[(int)(n)->partition-1+(code)/64]>>((code)%64))&1):(code))
+
+/*Class index of the leaf <row> reaches on <t>, or -1*/
+int __flat_leaf(flat_tree* t,const int* codes,const double* row,int col_stride)
+{
+    flat_node* n=t->nodes;
+    double v;
+    while(n->column>=0)
+    {
+        v=row[(long)n->column*col_stride];
+        if(!codes[n->column])n=t->nodes+n->child+!(v<=n->partition);
+        else if(v>=0&&v<codes[n->column])n=t->nodes+n->child+FLAT_BRANCH(t,n,(int)v);
+        else return -1;
+    }
+    return n->child;
+}
+
+/*Rows compiled_classify_rows takes through each tree together*/
+#define INTERLEAVE 8
+/*Trees smaller than this (32KB of nodes) stay on the L1 cache, where there's no latency to hide, so rows go through them one by one*/
+#define INTERLEAVE_NODES 2048
+
+/*
+Class indexes of the leaves <n> (up to INTERLEAVE) rows reach on <t>, written <stride> ints apart to <out>.
+The rows go down the tree in lockstep, one level at a time: each step loads a node for every row at once, and those
+loads don't depend on each other, so their latencies overlap instead of adding up.
+*/
+void __flat_leaves(flat_tree* t,const int* codes,const double* rows,int n,int row_stride,int col_stride,int* out,int stride)
+{
+    flat_node* node[INTERLEAVE],*nd;
+    const double* row[INTERLEAVE];
+    int r,moving=1,code;
+    double v;
+    for(r=0;r<n;r++)
+    {
+        node[r]=t->nodes;
+        row[r]=rows+(long)r*row_stride;
+    }
+    while(moving)
+    {
+        for(r=0,moving=0;r<n;r++)
         {
-            naconf.target=lab->self;
-            subsets[i]=filter_dataset(ds,f_by_name,&naconf);
-            if(ll_len(&subsets[i]->lines)==0)
-            {
-                len=i;
-                for(i=0;i<=len;i++)
-                {
-                    ll_free(&subsets[i]->lines);
-                    free(subsets[i]);
-                }
-                goto leaf;
-            }
-            lab=lab->next;
+            /*Rows that reached a leaf (or an unknown code, NULL) wait for the others*/
+            if(!(nd=node[r])||nd->column<0)continue;
+            v=row[r][(long)nd->column*col_stride];
+            if(!(code=codes[nd->column]))node[r]=t->nodes+nd->child+!(v<=nd->partition);
+            else node[r]=v>=0&&v<code?t->nodes+nd->child+FLAT_BRANCH(t,nd,(int)v):NULL;
+            moving=1;
         }
-        /*Chi-squared test*/
-        if(chi_squared(ds,subsets,len,classlabel->self)<chi_square_significance_limit)
+    }
+    for(r=0;r<n;r++)out[(long)r*stride]=node[r]?node[r]->child:-1;
+}
+
+/*Majority vote of the class indexes <leaves> of the trees of <f>, breaking ties like forest_classify. <votes> must be zeroed*/
+label* __compiled_vote(compiled_forest* f,const int* leaves,int* votes,int* order)
+{
+    int i,c,seen=0,max=0;
+    label* ret=NULL;
+    for(i=0;i<f->len;i++)if((c=leaves[i])>=0&&!votes[c]++)order[seen++]=c;
+    for(i=0;i<seen;i++)
+    {
+        if(votes[order[i]]>max)
         {
-            /*If it doesn't pass the test, we choose the biggest count and set ourselves as a leaf node*/
-            for(i=0;i<len;i++)
-            {
-                ll_free(&subsets[i]->lines);
-                free(subsets[i]);
-            }
-            goto leaf;
+            max=votes[order[i]];
+            ret=f->classes[order[i]];
         }
-        else
+        votes[order[i]]=0;
+    }
+    return ret;
+}
+
+label* compiled_classify(compiled_forest* f,const double* row)
+{
+    if(!f||!row)return NULL;
+    int votes[f->class_count+1],order[f->class_count+1],leaves[f->len+1],i;
+    memset(votes,0,sizeof(votes));
+    for(i=0;i<f->len;i++)leaves[i]=__flat_leaf(&f->trees[i],f->codes,row,1);
+    return __compiled_vote(f,leaves,votes,order);
+}
+
+void compiled_classify_rows(compiled_forest* f,const double* rows,int len,int row_stride,int col_stride,label** out)
+{
+    if(!f||!rows||!out)return;
+    int votes[f->class_count+1],order[f->class_count+1],i,k,t,n;
+    int* leaves=malloc(sizeof(int)*(INTERLEAVE*f->len+1));
+    memset(votes,0,sizeof(votes));
+    for(i=0;i<len;i+=INTERLEAVE)
+    {
+        n=len-i<INTERLEAVE?len-i:INTERLEAVE;
+        for(k=0;k<n;k++)
+            for(t=0;t<f->len;t++)
+                if(f->trees[t].len<INTERLEAVE_NODES)leaves[k*f->len+t]=__flat_leaf(&f->trees[t],f->codes,rows+(long)(i+k)*row_stride,col_stride);
+        for(t=0;t<f->len;t++)
+            if(f->trees[t].len>=INTERLEAVE_NODES)
+                __flat_leaves(&f->trees[t],f->codes,rows+(long)i*row_stride,n,row_stride,col_stride,leaves+t,f->len);
+        for(k=0;k<n;k++)out[i+k]=__compiled_vote(f,leaves+k*f->len,votes,order);
+    }
+    free(leaves);
+}
+
+double* dataset_rows(dataset* ds)
+{
+    if(!ds)return NULL;
+    int cols=ll_len(&ds->col_labels),i;
+    double* ret=malloc(sizeof(double)*((size_t)ll_len(&ds->lines)*cols+1)),*row=ret;
+    tree_ll* line,*entry,*col;
+    for(line=ds->lines;line;line=line->next,row+=cols)
+    {
+        for(entry=line->self,col=ds->col_labels,i=0;entry&&col;entry=entry->next,col=col->next,i++)
         {
-            /*If the division is not statistically insignificant, we can keep it*/
-            working=ll_push(&(*root)->subtrees,malloc(sizeof(tree_node*)));
-            fit_tree((tree_node**)&working->self,subsets[0],chi_square_significance_limit,classfield);
-            ll_free(&subsets[0]->lines);
-            free(subsets[0]);
-            for(i=1;i<len;i++)
-            {
-                working=ll_push(&working,malloc(sizeof(tree_node*)));
-                fit_tree((tree_node**)&working->self,subsets[i],chi_square_significance_limit,classfield);
-                ll_free(&subsets[i]->lines);
-                free(subsets[i]);
-            }
+            if(((label*)col->self)->type==LABEL_NUM)row[i]=*(double*)entry->self;
+            else row[i]=sublabel_index(((label*)col->self)->sublabels,entry->self);
         }
     }
-    return;
-    leaf:
-    lab=((label*)classlabel->self)->sublabels;
-    mi=0;
-    while(lab)
+    return ret;
+}
+
+/*Number of children of a compiled node (0 for leaves)*/
+int __flat_children(compiled_forest* f,flat_node* n)
+{
+    if(n->column<0)return 0;
+    return f->codes[n->column]&&!n->partition?f->codes[n->column]:2;
+}
+
+/*A compiled tree being laid out again*/
+typedef struct _flat_layout{
+    compiled_forest* f;
+    flat_tree* t;
+    unsigned int* hits;/*Lines of the dataset that reached each node (LAYOUT_HOT only)*/
+    int* height;/*Levels of children blocks under each node (LAYOUT_VEB only)*/
+    int* moved;/*New index of each node*/
+    int next;
+}flat_layout;
+
+/*Places the children of node <i>, which always stay together*/
+void __layout_block(flat_layout* l,int i)
+{
+    flat_node* n=&l->t->nodes[i];
+    int k,count=__flat_children(l->f,n);
+    for(k=0;k<count;k++)l->moved[n->child+k]=l->next++;
+}
+
+/*Depth-first: the children of a node, then the subtree of each child (the hottest first, with <hits>)*/
+void __layout_depth(flat_layout* l,int i)
+{
+    flat_node* n=&l->t->nodes[i];
+    int count=__flat_children(l->f,n),order[count+1],j,k,tmp;
+    if(!count)return;
+    __layout_block(l,i);
+    for(k=0;k<count;k++)order[k]=n->child+k;
+    if(l->hits)
     {
-        i=reduce(ds,classfield,r_count,lab->self,0);
-        if(i>mi)
+        /*Insertion sort, so children with the same hits keep their order*/
+        for(k=1;k<count;k++)
         {
-            mi=i;
-            l=lab->self;
+            for(j=k,tmp=order[k];j>0&&l->hits[order[j-1]]<l->hits[tmp];j--)order[j]=order[j-1];
+            order[j]=tmp;
         }
-        lab=lab->next;
     }
-    (*root)->attribute=l;
-    (*root)->partition=0;
-    (*root)->subtrees=NULL;
+    for(k=0;k<count;k++)__layout_depth(l,order[k]);
 }
 
-int tree_size(tree_node* root)
+void __layout_breadth(flat_layout* l)
 {
-    int s=1;
-    if(!root)return 0;
-    tree_ll* subtree=root->subtrees;
-    foreach(subtree,
+    int* queue=malloc(sizeof(int)*l->t->len),head=0,tail=1,k,count;
+    queue[0]=0;
+    while(head<tail)
     {
-        s+=tree_size(subtree->self);
-    });
-    return s;
+        count=__flat_children(l->f,&l->t->nodes[queue[head]]);
+        __layout_block(l,queue[head]);
+        for(k=0;k<count;k++)queue[tail++]=l->t->nodes[queue[head]].child+k;
+        head++;
+    }
+    free(queue);
 }
 
-tree_node* clone_tree(tree_node* root)
+int __layout_height(flat_layout* l,int i)
 {
-    if(!root)return NULL;
-    tree_node* ret=malloc(sizeof(tree_node));
-    tree_ll* subtree;
-    ret->attribute=root->attribute;
-    ret->partition=root->partition;
-    ret->subtrees=NULL;
-    subtree=root->subtrees;
-    foreach(subtree,{
-        ll_push(&ret->subtrees,clone_tree(subtree->self));
-    });
-    return ret;
+    flat_node* n=&l->t->nodes[i];
+    int k,h,count=__flat_children(l->f,n);
+    l->height[i]=0;
+    for(k=0;k<count;k++)if((h=__layout_height(l,n->child+k))>l->height[i])l->height[i]=h;
+    if(count)l->height[i]++;
+    return l->height[i];
 }
 
-void free_tree(tree_node** root)
+void __layout_veb(flat_layout* l,int i,int h);
+
+/*Lays out the <h> levels of blocks under each node whose block is <depth> levels under the block of node <i>*/
+void __layout_frontier(flat_layout* l,int i,int depth,int h)
 {
-    if(!root||!(*root))return;
-    tree_ll* subtree=(*root)->subtrees;
-    foreach(subtree,{
-        free_tree((tree_node**)&subtree->self);
-    });
-    free(*root);
-    *root=NULL;
+    flat_node* n=&l->t->nodes[i];
+    int k,count=__flat_children(l->f,n);
+    for(k=0;k<count;k++)
+    {
+        if(!l->height[n->child+k])continue;
+        if(depth==1)__layout_veb(l,n->child+k,h);
+        else __layout_frontier(l,n->child+k,depth-1,h);
+    }
 }
 
-double _prune_tree(tree_node** root,dataset* ds,char* classfield,tree_node* orig_tree)
+/*
+van Emde Boas: the top half of the levels of blocks under node <i>, then each subtree under them, both laid out the same
+way, so that any path crosses about log(depth) groups of nearby blocks whatever the size of a cache line or page.
+*/
+void __layout_veb(flat_layout* l,int i,int h)
 {
-    double score=0,pscore=0;
-    unsigned int idx=0;
-    label* leaf=NULL;
-    char all_leaves=1,all_eq=1,prune_anyways=0;
-    tree_ll* subtree,*subsubtree;
-    tree_node bkp;
-    dataset* subset;
-    f_numberfilter numconf;
-    f_namefilter namconf;
-    if(!root||!(*root)||!(*root)->subtrees||!ds||!ds->lines)return 0;
-    pscore=tree_score(orig_tree,ds,classfield);
-    subtree=(*root)->subtrees;
-    foreach(subtree,{
-        if((subsubtree=((tree_node*)(subtree->self))->subtrees))
-        {
-            all_leaves=0;
-            foreach(subsubtree,({
-                if(((tree_node*)subsubtree->self)->attribute->type==LABEL_NUM)
-                {
-                    numconf.bt=idx;
-                    numconf.field_index=select_label_index(ds->col_labels,((tree_node*)subsubtree->self)->attribute->name);
-                    numconf.target=((tree_node*)subsubtree->self)->partition;
-                    subset=filter_dataset(ds,f_by_number,&numconf);
-                }
-                else
-                {
-                    namconf.field_index=select_label_index(ds->col_labels,((tree_node*)subsubtree->self)->attribute->name);
-                    namconf.target=select_label_by_index(((tree_node*)subsubtree->self)->attribute->sublabels,idx);
-                    subset=filter_dataset(ds,f_by_name,&namconf);
-                }
-                if(!subset->lines){
-                    prune_anyways=1;
-                    free(subset);
-                    break;
-                }
-                while(prune_tree((tree_node**)&subsubtree->self,subset,classfield));
-                ll_free(&subset->lines);
-                free(subset);
-            }));
-        }
-        else
-        {
-            if(all_eq)
-            {
-                if(leaf)
-                {
-                    all_eq=all_eq&&((tree_node*)(subtree->self))->attribute==leaf;
-                }
-                else
-                {
-                    leaf=((tree_node*)(subtree->self))->attribute;
-                }
-            }
-        }
-        idx++;
-    });
-    if(all_leaves)
+    int top=h/2;
+    if(h<=1)
     {
-        if(all_eq)
-        {
-            subtree=(*root)->subtrees;
-            foreach(subtree,{
-                free(subtree->self);
-            });
-            ll_free(&(*root)->subtrees);
-            (*root)->partition=0;
-            (*root)->attribute=leaf;
-            return -1;
-        }
-        else
-        {
-            bkp=**root;
-            (*root)->attribute=most_frequent_class(&bkp,ds,classfield);
-            (*root)->partition=0;
-            (*root)->subtrees=NULL;
-            score=tree_score(orig_tree,ds,classfield);
-            if(score<pscore)
-            {
-                **root=bkp;
-            }
-            else
-            {
-                ll_free_self(&bkp.subtrees);
-            }
-        }
+        __layout_block(l,i);
+        return;
     }
-    else if(prune_anyways)
+    __layout_veb(l,i,top);
+    __layout_frontier(l,i,top,h-top);
+}
+
+/*Lines of <rows> that reach each node of <t>*/
+unsigned int* __flat_hits(compiled_forest* f,flat_tree* t,const double* rows,int len)
+{
+    unsigned int* ret=calloc(t->len,sizeof(unsigned int));
+    const double* row;
+    flat_node* n;
+    int i;
+    for(i=0,row=rows;i<len;i++,row+=f->cols)
     {
-        bkp=**root;
-        (*root)->attribute=most_frequent_class(&bkp,ds,classfield);
-        (*root)->partition=0;
-        (*root)->subtrees=NULL;
-        score=tree_score(orig_tree,ds,classfield);
-        if(score<pscore)
-        {
-            **root=bkp;
-        }
-        else
+        n=t->nodes;
+        ret[0]++;
+        while(n->column>=0)
         {
-            ll_free_self(&bkp.subtrees);
+            if(!f->codes[n->column])n=t->nodes+n->child+!(row[n->column]<=n->partition);
+            else if(row[n->column]>=0&&row[n->column]<f->codes[n->column])n=t->nodes+n->child+FLAT_BRANCH(t,n,(int)row[n->column]);
+            else break;
+            ret[n-t->nodes]++;
         }
     }
-    else return 0;
-    score=tree_score(orig_tree,ds,classfield);
-    return pscore-score;
+    return ret;
+}
+
+/*Moves the nodes of <t> (compiled depth-first) to <layout> order*/
+void __layout_tree(compiled_forest* f,flat_tree* t,char layout,const double* rows,int len)
+{
+    flat_layout l;
+    flat_node* nodes;
+    int i;
+    l.f=f;
+    l.t=t;
+    l.hits=layout==LAYOUT_HOT&&rows?__flat_hits(f,t,rows,len):NULL;
+    l.height=NULL;
+    l.moved=malloc(sizeof(int)*t->len);
+    l.moved[0]=0;
+    l.next=1;
+    if(layout==LAYOUT_BREADTH_FIRST)__layout_breadth(&l);
+    else if(layout==LAYOUT_VEB)
+    {
+        l.height=malloc(sizeof(int)*t->len);
+        __layout_veb(&l,0,__layout_height(&l,0));
+    }
+    else __layout_depth(&l,0);
+    nodes=malloc(sizeof(flat_node)*t->len);
+    for(i=0;i<t->len;i++)
+    {
+        nodes[l.moved[i]]=t->nodes[i];
+        if(t->nodes[i].column>=0)nodes[l.moved[i]].child=l.moved[t->nodes[i].child];
+    }
+    free(t->nodes);
+    t->nodes=nodes;
+    free(l.hits);
+    free(l.height);
+    free(l.moved);
+}
+
+compiled_forest* forest_compile_layout(forest a,tree_ll* columns,char layout,dataset* ds)
+{
+    compiled_forest* ret=forest_compile(a,columns);
+    double* rows=NULL;
+    int i,len=0;
+    if(!ret||layout==LAYOUT_DEPTH_FIRST)return ret;
+    if(layout==LAYOUT_HOT&&ds)
+    {
+        rows=dataset_rows(ds);
+        len=ll_len(&ds->lines);
+    }
+    for(i=0;i<ret->len;i++)__layout_tree(ret,&ret->trees[i],layout,rows,len);
+    ret->layout=layout;
+    free(rows);
+    return ret;
+}
+
+void free_compiled_forest(compiled_forest** f)
+{
+    if(!f||!*f)return;
+    int i;
+    for(i=0;i<(*f)->len;i++)
+    {
+        free((*f)->trees[i].nodes);
+        free((*f)->trees[i].subsets);
+    }
+    free((*f)->trees);
+    free((*f)->classes);
+    free((*f)->codes);
+    free(*f);
+    *f=NULL;
 }
 
-double prune_tree(tree_node** root,dataset* ds,char* classfield)
+/*Rows classified together by quickscorer_classify_rows, so each condition is checked against a block at once*/
+#define QS_BLOCK 128
+
+/*A condition being built, before they're sorted by feature and threshold*/
+typedef struct _qs_build{
+    int column;
+    double threshold;
+    int tree,first,last;/*The leaves of the left subtree, which the condition rules out when it's false*/
+}qs_build;
+
+int __qs_buildcmp(const void* a,const void* b)
 {
-    double prev=0,cur;
-    while((cur=_prune_tree(root,ds,classfield,*root)))prev=cur;
-    return prev;
+    const qs_build* x=a,*y=b;
+    if(x->column!=y->column)return x->column-y->column;
+    return x->threshold<y->threshold?-1:x->threshold>y->threshold;
 }
 
-label* classify(tree_node* root,tree_ll* line,tree_ll* columns)
+/*Numbers the leaves of the subtree at node <i> in order, from *<leaf> on, collecting the conditions of its nodes*/
+void __qs_walk(compiled_forest* f,flat_tree* t,int tree,int i,int* leaf,int* leaf_class,qs_build** conds,int* len)
 {
-    if(!root||!line)return NULL;
-    if(!root->subtrees)return root->attribute;
-    int idx=0,i;
-    tree_ll* lab=columns,*subtree,*entry;
-    while(lab)
+    flat_node* n=&t->nodes[i];
+    int first=*leaf;
+    if(n->column<0)
     {
-        if(strncmp(((label*)lab->self)->name,root->attribute->name,64)==0)goto found;
-        lab=lab->next;
-        idx++;
+        leaf_class[(*leaf)++]=n->child;
+        return;
     }
-    return NULL;
-    found:
-    if(root->attribute->type==LABEL_NUM)
+    __qs_walk(f,t,tree,n->child,leaf,leaf_class,conds,len);
+    *conds=realloc(*conds,sizeof(qs_build)*(*len+1));
+    (*conds)[*len].column=n->column;
+    (*conds)[*len].threshold=n->partition;
+    (*conds)[*len].tree=tree;
+    (*conds)[*len].first=first;
+    (*conds)[*len].last=*leaf;
+    (*len)++;
+    __qs_walk(f,t,tree,n->child+1,leaf,leaf_class,conds,len);
+}
+
+quickscorer* quickscorer_compile(compiled_forest* f)
+{
+    if(!f)return NULL;
+    quickscorer* ret;
+    qs_build* conds=NULL;
+    int i,k,w,leaves=0,len=0,leaf,masks=0;
+    unsigned long long word;
+    /*Only numerical splits are made of thresholds*/
+    for(i=0;i<f->len;i++)
+        for(k=0;k<f->trees[i].len;k++)if(f->trees[i].nodes[k].column>=0&&f->codes[f->trees[i].nodes[k].column])return NULL;
+    ret=malloc(sizeof(quickscorer));
+    ret->f=f;
+    ret->offsets=malloc(sizeof(int)*(f->len+1));
+    for(i=0,ret->offsets[0]=0;i<f->len;i++)
     {
-        lab=line;
-        for(i=0;i<idx;i++)lab=lab->next;
-        if(*(double*)lab->self<=root->partition)
-        {
-            return classify(root->subtrees->self,line,columns);
-        }
-        else return classify(root->subtrees->next->self,line,columns);
+        for(k=0,leaf=0;k<f->trees[i].len;k++)leaf+=f->trees[i].nodes[k].column<0;
+        leaves+=leaf;
+        ret->offsets[i+1]=ret->offsets[i]+(leaf+63)/64;
     }
-    else
+    ret->words=ret->offsets[f->len];
+    /*Each tree's leaves start on a word of their own (the bits past its last leaf are never the leftmost one left)*/
+    ret->leaf_class=malloc(sizeof(int)*(ret->words*64+1));
+    for(i=0;i<f->len;i++)
     {
-        lab=root->attribute->sublabels;
-        entry=line;
-        for(i=0;i<idx;i++){entry=entry->next;}
-        subtree=root->subtrees;
-        while(lab)
+        leaf=ret->offsets[i]*64;
+        __qs_walk(f,&f->trees[i],i,0,&leaf,ret->leaf_class,&conds,&len);
+    }
+    qsort(conds,len,sizeof(qs_build),__qs_buildcmp);
+    ret->features=calloc(f->cols+1,sizeof(int));
+    ret->conditions=malloc(sizeof(qs_condition)*(len+1));
+    for(i=0;i<len;i++)masks+=conds[i].last/64-conds[i].first/64;
+    ret->masks=malloc(sizeof(unsigned long long)*(masks+1));
+    for(i=0,masks=0;i<len;i++)
+    {
+        ret->features[conds[i].column+1]=i+1;
+        ret->conditions[i].threshold=conds[i].threshold;
+        /*Leaf numbers are global, so the words of the mask are the words of the bitvectors of all the trees*/
+        ret->conditions[i].word=conds[i].first/64;
+        ret->conditions[i].extra=(conds[i].last-1)/64-conds[i].first/64;
+        ret->conditions[i].more=masks;
+        for(w=0;w<=ret->conditions[i].extra;w++)
         {
-            if(entry->self==lab->self)return classify(subtree->self,line,columns);
-            lab=lab->next;
-            subtree=subtree->next;
+            for(word=~0ULL,k=(ret->conditions[i].word+w)*64;k<(ret->conditions[i].word+w)*64+64;k++)
+                if(k>=conds[i].first&&k<conds[i].last)word&=~(1ULL<<(k%64));
+            if(w)ret->masks[masks++]=word;
+            else ret->conditions[i].mask=word;
         }
     }
-    return NULL;
+    /*Each feature's conditions end where the next one's start*/
+    for(i=1;i<=f->cols;i++)if(ret->features[i]<ret->features[i-1])ret->features[i]=ret->features[i-1];
+    ret->len=len;
+    free(conds);
+    return ret;
 }
 
-double tree_score(tree_node* root,dataset* ds,char* classfield)
+/*
+Rules out the leaves of every false condition for <len> (at most QS_BLOCK) rows.
+Their bitvectors are interleaved, word w of row i being v[w*len+i], so a condition ANDs one contiguous run of words
+*/
+void __qs_score(quickscorer* q,const double* rows,int len,int row_stride,int col_stride,unsigned long long* v)
 {
-    int tests=ll_len(&ds->lines),right=0;
-    tree_ll* line;
-    label* lab;
-    line=ds->lines;
-    while(line)
+    int col,i,w,end;
+    double x[QS_BLOCK];
+    qs_condition* c,*last;
+    for(col=0;col<q->f->cols;col++)
     {
-        lab=classify(root,line->self,ds->col_labels);
-        right+=get_entry_by_label_name(line->self,ds->col_labels,classfield)==lab;
-        line=line->next;
+        if(q->features[col]==(end=q->features[col+1]))continue;
+        for(i=0;i<len;i++)x[i]=rows[(long)i*row_stride+(long)col*col_stride];
+        /*Thresholds are ascending, so once every row passes one (NaN fails them all, like classify) the rest pass too*/
+        for(c=q->conditions+q->features[col],last=q->conditions+end;
+            c<last&&mask_and_gt(x,len,c->threshold,c->mask,v+(long)c->word*len);c++)
+            for(w=0;w<c->extra;w++)mask_and_gt(x,len,c->threshold,q->masks[c->more+w],v+(long)(c->word+1+w)*len);
     }
-    return (double)right/(double)tests;
 }
 
-void _print_tree(tree_node* root,int l)
+/*Majority vote of the exit leaves of bitvectors <v>, whose words are <stride> apart. <votes> must be zeroed*/
+label* __qs_vote(quickscorer* q,unsigned long long* v,int stride,int* votes,int* order)
 {
-    if(!root)return;
-    int i;
-    tree_ll* curtree,*curatt;
-    for(i=0;i<l;i++)printf("\t");
-    printf("[%s]",root->attribute->name);
-    curtree=root->subtrees;
-    if(!curtree)printf("*\n");
-    else
+    int t,w,c,seen=0,max=0;
+    label* ret=NULL;
+    for(t=0;t<q->f->len;t++)
     {
-        printf("\n");
-        if(root->attribute->type==LABEL_NUM)
+        /*The exit leaf is the leftmost one left*/
+        for(w=q->offsets[t];w<q->offsets[t+1]&&!v[(long)w*stride];w++);
+        if(w<q->offsets[t+1]&&(c=q->leaf_class[w*64+__builtin_ctzll(v[(long)w*stride])])>=0&&!votes[c]++)
+            order[seen++]=c;
+    }
+    for(t=0;t<seen;t++)
+    {
+        if(votes[order[t]]>max)
         {
-            for(i=0;i<l;i++)printf("\t");
-            printf("  <=(%.2lf)->\n",root->partition);
-            _print_tree(curtree->self,l+1);
-            curtree=curtree->next;
-            for(i=0;i<l;i++)printf("\t");
-            printf("   >(%.2lf)->\n",root->partition);
-            _print_tree(curtree->self,l+1);
+            max=votes[order[t]];
+            ret=q->f->classes[order[t]];
         }
-        else
+        votes[order[t]]=0;
+    }
+    return ret;
+}
+
+label* quickscorer_classify(quickscorer* q,const double* row)
+{
+    if(!q||!row)return NULL;
+    unsigned long long v[q->words+1];
+    int votes[q->f->class_count+1],order[q->f->class_count+1],col,w;
+    qs_condition* c,*last;
+    memset(v,0xff,sizeof(v));
+    memset(votes,0,sizeof(votes));
+    /*A single row is cheaper to check condition by condition than with a kernel call each (see __qs_score)*/
+    for(col=0;col<q->f->cols;col++)
+    {
+        last=q->conditions+q->features[col+1];
+        for(c=q->conditions+q->features[col];c<last&&!(row[col]<=c->threshold);c++)
         {
-            curatt=root->attribute->sublabels;
-            while(curtree)
-            {
-                for(i=0;i<l;i++)printf("\t");
-                printf("  (%s)->\n",((label*)curatt->self)->name);
-                _print_tree(curtree->self,l+1);
-                curtree=curtree->next;
-                curatt=curatt->next;
-            }
+            v[c->word]&=c->mask;
+            for(w=0;w<c->extra;w++)v[c->word+1+w]&=q->masks[c->more+w];
         }
     }
+    return __qs_vote(q,v,1,votes,order);
 }
-void print_tree(tree_node* root)
+
+void quickscorer_classify_rows(quickscorer* q,const double* rows,int len,int row_stride,int col_stride,label** out)
 {
-    if(!root)return;
-    _print_tree(root,0);
+    if(!q||!rows||!out)return;
+    unsigned long long* v=malloc(sizeof(unsigned long long)*QS_BLOCK*(q->words+1));
+    int votes[q->f->class_count+1],order[q->f->class_count+1],i,k,n;
+    memset(votes,0,sizeof(votes));
+    for(i=0;i<len;i+=QS_BLOCK)
+    {
+        n=len-i<QS_BLOCK?len-i:QS_BLOCK;
+        memset(v,0xff,sizeof(unsigned long long)*n*q->words);
+        __qs_score(q,rows+(long)i*row_stride,n,row_stride,col_stride,v);
+        for(k=0;k<n;k++)out[i+k]=__qs_vote(q,v+k,n,votes,order);
+    }
+    free(v);
 }
 
-/*
-Forests
-*/
+void free_quickscorer(quickscorer** q)
+{
+    if(!q||!*q)return;
+    free((*q)->offsets);
+    free((*q)->leaf_class);
+    free((*q)->features);
+    free((*q)->conditions);
+    free((*q)->masks);
+    free(*q);
+    *q=NULL;
+}
 
-double fit_forest(forest* a,dataset* ds,char* classfield,int max_size,double subset_relative_size)
+double forest_score(forest a,dataset* ds,char* classfield)
 {
-    int i,slen;
-    if(!a||!ds||max_size==0||((slen=ll_len(&ds->lines)*subset_relative_size)==0))return 0;
-    dataset* subset,*pruning_subset;
-    tree_node* current_tree;
-    tree_ll* tree,*next;
-    double score,pscore;
-    pscore=forest_score(*a,ds,classfield);
-    /*First we fill the forest up to the maximum size*/
-    for(i=ll_len(a);i<max_size;i++)
-    {
-        subset=sample_dataset(ds,slen,classfield);
-        pruning_subset=sample_dataset(ds,slen,classfield);
-        current_tree=NULL;
-        fflush(stdout);
+    if(!a||!ds)return 0;
+    tree_ll* line=ds->lines;
+    int len=ll_len(&ds->lines),right=0;
+    foreach(line,{
+        right+=forest_classify(a,line->self,ds->col_labels)==get_entry_by_label_name(line->self,ds->col_labels,classfield);
+    });
+    return (double)right/(double)len;
+}
 
-        fit_tree(&current_tree,subset,0,classfield);
-        prune_tree(&current_tree,pruning_subset,classfield);
+double forest_oob_score(forest a,dataset* ds,char* classfield)
+{
+    if(!a||!ds)return 0;
+    oob_table* table=oob_table_build(a,ds,classfield);
+    double ret;
+    if(!table)return 0;
+    ret=oob_table_score(table);
+    oob_table_free(table);
+    return ret;
+}
 
-        ll_push(a,current_tree);
+void free_forest(forest* a)
+{
+    if(!a)return;
+    tree_ll* tree=*a;
+    foreach(tree,{
+        free_tree((tree_node**)&tree->self);
+    });
+    ll_free(a);
+}
 
-        ll_free(&subset->lines);
-        ll_free(&pruning_subset->lines);
-        free(subset);
-        free(pruning_subset);
-    }
-    /*Then we chop down the trees that hinder its performance in the full dataset*/
-    tree=*a;
-    while(tree)
+void free_columns(tree_ll** columns)
+{
+    if(!columns)return;
+    tree_ll* column=*columns;
+    foreach(column,{
+        ll_free_self(&((label*)column->self)->sublabels);
+    });
+    ll_free_self(columns);
+}
+
+/*
+Model files are text: the columns (type, precision, number of sublabels and name, then the name of each sublabel on its
+own line), then every tree in preorder, one node per line:
+N <column index> <partition> <number of subtrees>
+S <column index> <number of sublabels> (a binary categorical split, followed by the words of its bitset, in hexadecimal,
+one per line, then its two subtrees)
+L <column index> <sublabel index> (the class of a leaf; -1 -1 if it has none)
+Partitions are written as hexadecimal floats, so they're read back exactly.
+*/
+#define MODEL_HEADER "treeclassifier forest 1"
+
+/*Finds a label among <columns> (<col> is the column, <sub> its sublabel index, or -1 for the column itself)*/
+char __model_find(tree_ll* columns,label* lab,int* col,int* sub)
+{
+    tree_ll* cur,*s;
+    for(cur=columns,*col=0;cur;cur=cur->next,(*col)++)
     {
-        next=tree->next;
-        score=forest_score(*a,ds,classfield);
-        current_tree=tree->self;
-        if(!tree->prev)
-        {
-            if(!next)*a=NULL;
-            else *a=(*a)->next;
-        }
-        ll_remove(&tree);
-        if(score>forest_score(*a,ds,classfield))
+        if(cur->self==lab)
         {
-            *a=ll_push_reverse(a,current_tree);
+            *sub=-1;
+            return 1;
         }
-        tree=next;
+        for(s=((label*)cur->self)->sublabels,*sub=0;s;s=s->next,(*sub)++)if(s->self==lab)return 1;
     }
-    return forest_score(*a,ds,classfield)-pscore;
+    return 0;
 }
 
-double fit_random_forest(forest* a,dataset* ds,char* classfield,int max_size,double subset_relative_size)
+char __save_tree(FILE* fp,tree_node* node,tree_ll* columns)
 {
-    int i,slen;
-    if(!a||!ds||max_size==0||((slen=ll_len(&ds->lines)*subset_relative_size)==0))return 0;
-    dataset* subset,*pruning_subset;
-    tree_node* current_tree;
-    tree_ll* tree,*next;
-    double score,pscore;
-    pscore=forest_score(*a,ds,classfield);
-    /*First we fill the forest up to the maximum size*/
-    for(i=ll_len(a);i<max_size;i++)
+    int col=-1,sub=-1,i;
+    tree_ll* subtree;
+    if(!node->subtrees)
     {
-        subset=sample_dataset(ds,slen,classfield);
-        pruning_subset=sample_dataset(ds,slen,classfield);
-        current_tree=NULL;
-        fflush(stdout);
+        if(node->attribute&&!__model_find(columns,node->attribute,&col,&sub))return 0;
+        fprintf(fp,"L %d %d\n",col,sub);
+        return 1;
+    }
+    if(!__model_find(columns,node->attribute,&col,&sub)||sub!=-1)return 0;
+    if(node->subset)
+    {
+        fprintf(fp,"S %d %d\n",col,(int)node->partition);
+        for(i=0;i<MASK_WORDS((int)node->partition);i++)fprintf(fp,"%llx\n",node->subset[i]);
+    }
+    else fprintf(fp,"N %d %a %d\n",col,node->partition,ll_len(&node->subtrees));
+    for(subtree=node->subtrees;subtree;subtree=subtree->next)if(!__save_tree(fp,subtree->self,columns))return 0;
+    return 1;
+}
 
-        fit_random_tree(&current_tree,subset,0,classfield);
-        prune_tree(&current_tree,pruning_subset,classfield);
+char forest_save(forest a,tree_ll* columns,const char* fname)
+{
+    if(!a||!columns||!fname)return 0;
+    FILE* fp=fopen(fname,"w");
+    tree_ll* cur,*s;
+    label* lab;
+    char ok=1;
+    if(!fp)return 0;
+    fprintf(fp,MODEL_HEADER"\ncolumns %d\n",ll_len(&columns));
+    for(cur=columns;cur;cur=cur->next)
+    {
+        lab=cur->self;
+        fprintf(fp,"%d %d %d %s\n",lab->type,lab->precision,ll_len(&lab->sublabels),lab->name);
+        for(s=lab->sublabels;s;s=s->next)fprintf(fp,"%s\n",((label*)s->self)->name);
+    }
+    fprintf(fp,"trees %d\n",ll_len(&a));
+    for(cur=a;cur&&ok;cur=cur->next)ok=__save_tree(fp,cur->self,columns);
+    if(!ok)printf("KeyError: The forest has labels that aren't in its columns. Could not save it.\n");
+    if(fclose(fp)!=0)ok=0;
+    return ok;
+}
 
-        ll_push(a,current_tree);
+#define MODEL_LINE 128
+
+/*Reads a line (without its newline) into <buf>, which holds MODEL_LINE characters*/
+char __model_line(FILE* fp,char* buf)
+{
+    size_t len;
+    if(!fgets(buf,MODEL_LINE,fp))return 0;
+    len=strlen(buf);
+    if(len&&buf[len-1]=='\n')buf[--len]=0;
+    return 1;
+}
 
-        ll_free(&subset->lines);
-        ll_free(&pruning_subset->lines);
-        free(subset);
-        free(pruning_subset);
+tree_node* __load_tree(FILE* fp,label** labels,int cols)
+{
+    char buf[MODEL_LINE],*end;
+    long col,sub,len,i;
+    tree_node* ret,*child;
+    tree_ll* lab,*tail=NULL;
+    if(!__model_line(fp,buf)||(buf[0]!='L'&&buf[0]!='N'&&buf[0]!='S'))return NULL;
+    col=strtol(buf+1,&end,10);
+    if(col<-1||col>=cols)return NULL;
+    ret=calloc(1,sizeof(tree_node));
+    if(buf[0]=='L')
+    {
+        sub=strtol(end,&end,10);
+        if(col<0)return ret;
+        for(lab=labels[col]->sublabels;lab&&sub>0;sub--)lab=lab->next;
+        if(!lab||sub<0)goto fail;
+        ret->attribute=lab->self;
+        return ret;
     }
-    /*Then we chop down the trees that hinder its performance in the full dataset*/
-    tree=*a;
-    while(tree)
+    if(col<0)goto fail;
+    ret->attribute=labels[col];
+    if(buf[0]=='S')
     {
-        next=tree->next;
-        score=forest_score(*a,ds,classfield);
-        current_tree=tree->self;
-        if(!tree->prev)
+        /*The bitset must cover every sublabel of the column*/
+        len=strtol(end,&end,10);
+        if(labels[col]->type!=LABEL_CAT||len<1||len!=ll_len(&labels[col]->sublabels))goto fail;
+        ret->partition=len;
+        ret->subset=malloc(sizeof(unsigned long long)*(MASK_WORDS(len)+1));
+        for(i=0;i<MASK_WORDS(len);i++)
         {
-            if(!next)*a=NULL;
-            else *a=(*a)->next;
-        }
-        ll_remove(&tree);
-        if(score>forest_score(*a,ds,classfield))
-        {
-            *a=ll_push_reverse(a,current_tree);
+            if(!__model_line(fp,buf))goto fail;
+            ret->subset[i]=strtoull(buf,&end,16);
+            if(end==buf||*end)goto fail;
         }
-        tree=next;
+        len=2;
     }
-    return forest_score(*a,ds,classfield)-pscore;
+    else
+    {
+        ret->partition=strtod(end,&end);
+        len=strtol(end,&end,10);
+        /*Numerical splits have two subtrees, categorical ones one per sublabel of the column*/
+        if(len!=(labels[col]->type==LABEL_NUM?2:ll_len(&labels[col]->sublabels))||len<1)goto fail;
+    }
+    for(i=0;i<len;i++)
+    {
+        if(!(child=__load_tree(fp,labels,cols)))goto fail;
+        tail=ll_push(tail?&tail:&ret->subtrees,child);
+    }
+    return ret;
+    fail:
+    free_tree(&ret);
+    return NULL;
 }
 
-label* forest_classify(forest a,tree_ll* line,tree_ll* columns)
+forest forest_load(const char* fname,tree_ll** columns)
 {
-    tree_ll* frequencies=NULL,*labels=NULL,*current,*current_label;
-    label* class;
-    int idx,max=0;
-    foreach(a,
+    if(!fname||!columns)return NULL;
+    FILE* fp=fopen(fname,"r");
+    char buf[MODEL_LINE],*name;
+    int cols,type,precision,sublabels,trees,i,j;
+    label** labels=NULL;
+    tree_ll* col_tail=NULL,*sub_tail,*tree_tail=NULL;
+    tree_node* tree;
+    forest ret=NULL;
+    *columns=NULL;
+    if(!fp)return NULL;
+    if(!__model_line(fp,buf)||strcmp(buf,MODEL_HEADER)||!__model_line(fp,buf)||sscanf(buf,"columns %d",&cols)!=1||cols<0)
+        goto fail;
+    labels=calloc(cols+1,sizeof(label*));
+    for(i=0;i<cols;i++)
     {
-        class=classify(a->self,line,columns);
-        idx=select_label_index(labels,class->name);
-        if(idx==-1)
-        {
-            idx=ll_len(&labels);
-            ll_push(&labels,class);
-            ll_push(&frequencies,calloc(1,sizeof(unsigned int)));
-        }
-        (*(unsigned int*)select_by_index(frequencies,idx))++;
-    });
-    current=frequencies;
-    current_label=labels;
-    foreach(current,{
-        if(*(unsigned int*)current->self>max)
+        if(!__model_line(fp,buf)||sscanf(buf,"%d %d %d",&type,&precision,&sublabels)!=3)goto fail;
+        if((type!=LABEL_NUM&&type!=LABEL_CAT)||(precision!=PRECISION_DOUBLE&&precision!=PRECISION_FLOAT)||sublabels<0)
+            goto fail;
+        /*The name is what follows the third number*/
+        for(name=buf,j=0;j<3&&name;j++)if((name=strchr(name,' ')))name++;
+        if(!name||strlen(name)>63)goto fail;
+        labels[i]=Label(name,type);
+        labels[i]->precision=precision;
+        col_tail=ll_push(col_tail?&col_tail:columns,labels[i]);
+        for(j=0,sub_tail=NULL;j<sublabels;j++)
         {
-            max=*(unsigned int*)current->self;
-            class=current_label->self;
+            if(!__model_line(fp,buf)||strlen(buf)>63)goto fail;
+            sub_tail=ll_push(sub_tail?&sub_tail:&labels[i]->sublabels,Label(buf,LABEL_CAT));
         }
-        current_label=current_label->next;
-    });
-    ll_free(&current_label);
-    ll_free_self(&current);
-    return class;
+    }
+    /*A forest without trees can't classify anything, and NULL is the error*/
+    if(!__model_line(fp,buf)||sscanf(buf,"trees %d",&trees)!=1||trees<1)goto fail;
+    for(i=0;i<trees;i++)
+    {
+        if(!(tree=__load_tree(fp,labels,cols)))goto fail;
+        tree_tail=ll_push(tree_tail?&tree_tail:&ret,tree);
+    }
+    free(labels);
+    fclose(fp);
+    return ret;
+    fail:
+    printf("Format error: \"%s\" is not a valid model file.\n",fname);
+    free_forest(&ret);
+    free_columns(columns);
+    free(labels);
+    fclose(fp);
+    return NULL;
 }
 
-double forest_score(forest a,dataset* ds,char* classfield)
+struct _model_handle{
+    pthread_mutex_t lock;/*Held while taking a reference to the current model or replacing it*/
+    model* current;
+};
+
+/*Loads a model with a reference for being current*/
+model* __model_load(const char* fname)
 {
-    if(!a||!ds)return 0;
-    tree_ll* line=ds->lines;
-    int len=ll_len(&ds->lines),right=0;
-    foreach(line,{
-        right+=forest_classify(a,line->self,ds->col_labels)==get_entry_by_label_name(line->self,ds->col_labels,classfield);
-    });
-    return (double)right/(double)len;
-}
\ No newline at end of file
+    model* ret=malloc(sizeof(model));
+    if(!(ret->trees=forest_load(fname,&ret->columns)))
+    {
+        free(ret);
+        return NULL;
+    }
+    ret->compiled=forest_compile(ret->trees,ret->columns);
+    ret->refs=1;
+    return ret;
+}
+
+model_handle* model_open(const char* fname)
+{
+    model* m=__model_load(fname);
+    model_handle* ret;
+    if(!m)return NULL;
+    ret=malloc(sizeof(model_handle));
+    pthread_mutex_init(&ret->lock,NULL);
+    ret->current=m;
+    return ret;
+}
+
+model* model_acquire(model_handle* handle)
+{
+    if(!handle)return NULL;
+    model* ret;
+    /*Only a pointer and a counter are touched under the lock, so readers never wait for a model to load*/
+    pthread_mutex_lock(&handle->lock);
+    ret=handle->current;
+    __atomic_add_fetch(&ret->refs,1,__ATOMIC_RELAXED);
+    pthread_mutex_unlock(&handle->lock);
+    return ret;
+}
+
+void model_release(model* m)
+{
+    if(!m)return;
+    if(__atomic_sub_fetch(&m->refs,1,__ATOMIC_ACQ_REL))return;
+    /*That was the last reference: the model was replaced and every reader has left it*/
+    free_compiled_forest(&m->compiled);
+    free_forest(&m->trees);
+    free_columns(&m->columns);
+    free(m);
+}
+
+char model_reload(model_handle* handle,const char* fname)
+{
+    if(!handle)return 0;
+    model* m=__model_load(fname),*old;
+    if(!m)return 0;
+    pthread_mutex_lock(&handle->lock);
+    old=handle->current;
+    handle->current=m;
+    pthread_mutex_unlock(&handle->lock);
+    model_release(old);
+    return 1;
+}
+
+void model_close(model_handle** handle)
+{
+    if(!handle||!*handle)return;
+    model_release((*handle)->current);
+    pthread_mutex_destroy(&(*handle)->lock);
+    free(*handle);
+    *handle=NULL;
+}
@@ -11,6 +11,7 @@ int main()
     dataset* train=sample_dataset(data,ll_len(&data->lines)/2,"colour");
     dataset* prune=sample_dataset(train,ll_len(&train->lines)/2,"colour");
     tree_node* root=NULL;
+    tree_options opts;
     if(!data||!train)
     {
         printf("File not found.\n");
@@ -23,7 +24,9 @@ int main()
     printf("#prune...\n");
     infoDataset(prune);
     printf("Fitting...\n");
-    fit_tree(&root,train,0,"colour");
+    tree_options_init(&opts);
+    opts.threads=-1;
+    fit_tree_opts(&root,train,"colour",&opts);
     printf("Fitting completed.\nScore: %.2lf\nSize: %d\n",tree_score(root,data,"colour")*100,tree_size(root));
     printf("Pruning...\n");
     printf("Pruning improved score by %.4lf on pruning dataset.\n",prune_tree(&root,prune,"colour"));